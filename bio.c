@@ -105,6 +105,20 @@ bread(uint dev, uint blockno)
   return b;
 }
 
+// Return a locked buf for a block that the caller will
+// overwrite, such as a newly allocated one.  Its contents
+// are zeroed instead of being read from disk.
+struct buf*
+bnew(uint dev, uint blockno)
+{
+  struct buf *b;
+
+  b = bget(dev, blockno);
+  memset(b->data, 0, BSIZE);
+  b->flags |= B_VALID;
+  return b;
+}
+
 // Write b's contents to disk.  Must be locked.
 void
 bwrite(struct buf *b)
@@ -30,6 +30,7 @@
 //int currentCommandId = 0;
 
 static void consputc(int);
+static void cgasync(void);
 
 static int panicked = 0;
 
@@ -174,6 +175,7 @@ cprintf(char *fmt, ...)
       break;
     }
   }
+  cgasync();
 
   if(locking)
     release(&cons.lock);
@@ -217,16 +219,49 @@ struct {
 #define CRTPORT 0x3d4
 static ushort *crt = (ushort*)P2V(0xb8000);  // CGA memory
 
+// The cursor position, col + 80*row, shadows the CRT
+// controller's.  Output moves only the shadow; cgasync()
+// then updates the controller once per write.
+static int cgapos = -1;
+static int cgadirty;
+
+static int
+cgagetpos(void)
+{
+  if(cgapos < 0){
+    outb(CRTPORT, 14);
+    cgapos = inb(CRTPORT+1) << 8;
+    outb(CRTPORT, 15);
+    cgapos |= inb(CRTPORT+1);
+  }
+  return cgapos;
+}
+
 static void
-cgaputc(int c)
+cgasetpos(int pos)
 {
-  int pos;
+  cgapos = pos;
+  cgadirty = 1;
+}
 
-  // Cursor position: col + 80*row.
+static void
+cgasync(void)
+{
+  if(!cgadirty)
+    return;
+  cgadirty = 0;
   outb(CRTPORT, 14);
-  pos = inb(CRTPORT+1) << 8;
+  outb(CRTPORT+1, cgapos>>8);
   outb(CRTPORT, 15);
-  pos |= inb(CRTPORT+1);
+  outb(CRTPORT+1, cgapos);
+}
+
+static void
+cgaputc(int c)
+{
+  int pos;
+
+  pos = cgagetpos();
 
   if(c == '\n')
     pos += 80 - pos%80;
@@ -244,11 +279,8 @@ cgaputc(int c)
     memset(crt+pos, 0, sizeof(crt[0])*(24*80 - pos));
   }
 
-  outb(CRTPORT, 14);
-  outb(CRTPORT+1, pos>>8);
-  outb(CRTPORT, 15);
-  outb(CRTPORT+1, pos);
   crt[pos] = ' ' | 0x0700;
+  cgasetpos(pos);
 }
 
 
@@ -257,40 +289,28 @@ void vga_move_back_cursor(){
   int pos;
   
   // get cursor position
-  outb(CRTPORT, 14);                  
-  pos = inb(CRTPORT+1) << 8;
-  outb(CRTPORT, 15);
-  pos |= inb(CRTPORT+1);    
+  pos = cgagetpos();
 
   // move back
   pos--;
 
   // reset cursor
-  outb(CRTPORT, 15);
-  outb(CRTPORT+1, (unsigned char)(pos&0xFF));
-  outb(CRTPORT, 14);
-  outb(CRTPORT+1, (unsigned char )((pos>>8)&0xFF));
-  //crt[pos] = ' ' | 0x0700;
+  cgasetpos(pos);
+  cgasync();
 }
 
 void vga_move_forward_cursor(){
   int pos;
   
   // get cursor position
-  outb(CRTPORT, 14);                  
-  pos = inb(CRTPORT+1) << 8;
-  outb(CRTPORT, 15);
-  pos |= inb(CRTPORT+1);    
+  pos = cgagetpos();
 
   // move back
   pos++;
 
   // reset cursor
-  outb(CRTPORT, 15);
-  outb(CRTPORT+1, (unsigned char)(pos&0xFF));
-  outb(CRTPORT, 14);
-  outb(CRTPORT+1, (unsigned char )((pos>>8)&0xFF));
-  //crt[pos] = ' ' | 0x0700;
+  cgasetpos(pos);
+  cgasync();
 }
 
 /*
@@ -301,10 +321,7 @@ void vga_insert_char(int c, int back_counter){
   int pos;
 
   // get cursor position
-  outb(CRTPORT, 14);                  
-  pos = inb(CRTPORT+1) << 8;
-  outb(CRTPORT, 15);
-  pos |= inb(CRTPORT+1);
+  pos = cgagetpos();
 
   //move back crt buffer
   for(int i = pos + back_counter; i >= pos; i--){
@@ -315,10 +332,8 @@ void vga_insert_char(int c, int back_counter){
   // move cursor to next position
   pos += 1;
 
-  outb(CRTPORT, 14);
-  outb(CRTPORT+1, pos>>8);
-  outb(CRTPORT, 15);
-  outb(CRTPORT+1, pos);
+  cgasetpos(pos);
+  cgasync();
   crt[pos+back_counter] = ' ' | 0x0700;
 }
 
@@ -354,8 +369,10 @@ consputc(int c)
   }
 
   if(c == BACKSPACE){
-    uartputc('\b'); uartputc(' '); uartputc('\b');
-  } else
+    uartwrite("\b \b", 3);
+  } else if(!cons.locking)
+    uartputcsync(c);  // early boot or panic
+  else
     uartputc(c);
   cgaputc(c);
 }
@@ -434,10 +451,7 @@ consoleintr(int (*getc)(void))
       input.e--;
       input.pos--;
       back_counter +=1;
-      outb(CRTPORT, 14);                  
-      posi = inb(CRTPORT+1) << 8;
-      outb(CRTPORT, 15);
-      posi |= inb(CRTPORT+1);
+      posi = cgagetpos();
 
       //move back crt buffer
       for(int i = posi-1 ; i <= posi + back_counter; i++)
@@ -446,10 +460,8 @@ consoleintr(int (*getc)(void))
       // move cursor to next position
       posi -= 1;
 
-      outb(CRTPORT, 14);
-      outb(CRTPORT+1, posi>>8);
-      outb(CRTPORT, 15);
-      outb(CRTPORT+1, posi);
+      cgasetpos(posi);
+      cgasync();
       }
       break;
     /*case KEY_UP:                // last command in history
@@ -565,6 +577,7 @@ consoleintr(int (*getc)(void))
     }
   }
   //release(&input.lock);
+  cgasync();
   release(&cons.lock);
   if(doprocdump) {
     procdump();  // now call procdump() wo. cons.lock held
@@ -572,7 +585,7 @@ consoleintr(int (*getc)(void))
 }
 
 int
-consoleread(struct inode *ip, char *dst, int n)
+consoleread(struct inode *ip, char *dst, uint off, int n)
 {
  uint target;
   int c;
@@ -617,8 +630,15 @@ consolewrite(struct inode *ip, char *buf, int n)
 
   iunlock(ip);
   acquire(&cons.lock);
+  if(panicked){
+    cli();
+    for(;;)
+      ;
+  }
+  uartwrite(buf, n);
   for(i = 0; i < n; i++)
-    consputc(buf[i] & 0xff);
+    cgaputc(buf[i] & 0xff);
+  cgasync();
   release(&cons.lock);
   ilock(ip);
 
@@ -6,3 +6,25 @@ struct rtcdate {
   uint month;
   uint year;
 };
+
+// Monotonic time since boot, from clock_gettime().
+struct timespec {
+  uint tv_sec;
+  uint tv_nsec;
+};
+
+// The time page, mapped read-only at TIMEPAGE in every
+// process so that user code can read the clock without a
+// system call (see tsc.c).  Nanoseconds since boot are
+//   base_ns + ((rdtsc() - base_tsc) * mult >> shift)
+// for a copy read while seq was even and did not change.
+// mult is 0 if the TSC could not be calibrated.
+struct timepage {
+  uint sysenter;      // system calls may use sysenter (see usys.S)
+  volatile uint seq;  // odd while the kernel updates the page
+  uint mult;          // ns per TSC cycle, shifted left by shift
+  uint shift;
+  uint ticks;         // timer interrupts since boot
+  uint64 base_tsc;    // TSC at the last timer interrupt
+  uint64 base_ns;     // ns since boot at base_tsc
+};
@@ -2,17 +2,22 @@ struct buf;
 struct context;
 struct file;
 struct inode;
+struct lockclass;
 struct pipe;
 struct proc;
 struct rtcdate;
 struct spinlock;
+struct trevent;
 struct sleeplock;
+struct slabcache;
 struct stat;
+struct timespec;
 struct superblock;
 
 // bio.c
 void            binit(void);
 struct buf*     bread(uint, uint);
+struct buf*     bnew(uint, uint);
 void            brelse(struct buf*);
 void            bwrite(struct buf*);
 
@@ -33,6 +38,7 @@ void            fileinit(void);
 int             fileread(struct file*, char*, int n);
 int             filestat(struct file*, struct stat*);
 int             filewrite(struct file*, char*, int n);
+int             filesplice(struct file*, struct file*, int n);
 
 // fs.c
 void            readsb(int dev, struct superblock *sb);
@@ -44,6 +50,8 @@ void            iinit(int dev);
 void            ilock(struct inode*);
 void            iput(struct inode*);
 void            iunlock(struct inode*);
+void            ilockshared(struct inode*);
+void            iunlockshared(struct inode*);
 void            iunlockput(struct inode*);
 void            iupdate(struct inode*);
 int             namecmp(const char*, const char*);
@@ -68,6 +76,7 @@ char*           kalloc(void);
 void            kfree(char*);
 void            kinit1(void*, void*);
 void            kinit2(void*, void*);
+void            kdup(char*);
 
 // kbd.c
 void            kbdintr(void);
@@ -79,13 +88,31 @@ extern volatile uint*    lapic;
 void            lapiceoi(void);
 void            lapicinit(void);
 void            lapicstartap(uchar, uint);
+void            lapicipi(int, int);
 void            microdelay(int);
 
+// lockstat.c
+struct lockclass* lockclass(char*, int);
+void            lockstatacquire(struct lockclass*, uint, int, uint64);
+void            lockstatrelease(struct lockclass*, uint64);
+void            lockstatinit(void);
+
 // log.c
 void            initlog(int dev);
 void            log_write(struct buf*);
 void            begin_op();
 void            end_op();
+void            begin_opn(int);
+void            end_opn(int);
+
+// mmap.c
+int             mmap(uint, int, int, struct file*, uint);
+uint            mmapbase(struct proc*);
+void            mmapexit(struct proc*);
+int             mmapfault(struct proc*, uint, int);
+int             mmapfork(struct proc*, struct proc*);
+int             mmapprefault(struct proc*, uint, int, int);
+int             munmap(uint, uint);
 
 // mp.c
 extern int      ismp;
@@ -97,9 +124,15 @@ void            picinit(void);
 
 // pipe.c
 int             pipealloc(struct file**, struct file**);
+void            pipeinit(void);
 void            pipeclose(struct pipe*, int);
 int             piperead(struct pipe*, char*, int);
 int             pipewrite(struct pipe*, char*, int);
+int             pipesize(struct pipe*, int);
+int             pipebeginread(struct pipe*, char**, int, int);
+void            pipeendread(struct pipe*, int);
+int             pipebeginwrite(struct pipe*, char**, int);
+void            pipeendwrite(struct pipe*, int);
 
 //PAGEBREAK: 16
 // proc.c
@@ -116,6 +149,8 @@ void            scheduler(void) __attribute__((noreturn));
 void            sched(void);
 void            setproc(struct proc*);
 void            sleep(void*, struct spinlock*);
+int             sleepticks(uint);
+void            timertick(uint);
 void            userinit(void);
 int             wait(void);
 void            wakeup(void*);
@@ -136,8 +171,16 @@ void            popcli(void);
 // sleeplock.c
 void            acquiresleep(struct sleeplock*);
 void            releasesleep(struct sleeplock*);
+void            acquiresleepshared(struct sleeplock*);
+void            releasesleepshared(struct sleeplock*);
 int             holdingsleep(struct sleeplock*);
 void            initsleeplock(struct sleeplock*, char*);
+void            heldrunning(struct proc*, int);
+
+// slab.c
+void            slabinit(struct slabcache*, char*, uint, void(*)(void*));
+void*           slaballoc(struct slabcache*);
+void            slabfree(struct slabcache*, void*);
 
 // string.c
 int             memcmp(const void*, const void*, uint);
@@ -151,9 +194,12 @@ char*           strncpy(char*, const char*, int);
 // syscall.c
 int             argint(int, int*);
 int             argptr(int, char**, int);
-int             argstr(int, char**);
+int             argptrw(int, char**, int);
+int             argstr(int, char*, int);
 int             fetchint(uint, int*);
 int             fetchstr(uint, char**);
+int             copyinstr(uint, char*, int);
+int             fetchbuf(uint, int, int);
 void            syscall(void);
 
 // timer.c
@@ -165,14 +211,33 @@ extern uint     ticks;
 void            tvinit(void);
 extern struct spinlock tickslock;
 
+// trace.c
+void            trace(int, uint, uint);
+int             tracedrain(struct trevent*, int);
+void            traceinit(void);
+
+// tsc.c
+extern uint     tsckhz;
+int             maptimepage(pde_t*);
+uint64          nanotime(void);
+void            nstotimespec(uint64, struct timespec*);
+void            tscinit(void);
+void            tsctick(uint);
+uint64          tsctons(uint64);
+
 // uart.c
 void            uartinit(void);
 void            uartintr(void);
 void            uartputc(int);
+void            uartputcsync(int);
+void            uartwrite(char*, int);
 
 // vm.c
 void            seginit(void);
+int             sysenterok(void);
 void            kvmalloc(void);
+pte_t*          walkpgdir(pde_t*, const void*, int);
+int             mappages(pde_t*, void*, uint, uint, int);
 pde_t*          setupkvm(void);
 char*           uva2ka(pde_t*, char*);
 int             allocuvm(pde_t*, uint, uint);
@@ -185,6 +250,8 @@ void            switchuvm(struct proc*);
 void            switchkvm(void);
 int             copyout(pde_t*, uint, void*, uint);
 void            clearpteu(pde_t *pgdir, char *uva);
+int             mapinfo(pde_t*, char*);
+int             mapring(pde_t*);
 
 // number of elements in fixed-size array
 #define NELEM(x) (sizeof(x)/sizeof((x)[0]))
@@ -0,0 +1,3 @@
+// Major device numbers, indexes into devsw[].
+#define CONSOLE 1
+#define LOCKSTAT 2
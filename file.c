@@ -5,21 +5,24 @@
 #include "types.h"
 #include "defs.h"
 #include "param.h"
+#include "stat.h"
 #include "fs.h"
 #include "spinlock.h"
 #include "sleeplock.h"
 #include "file.h"
+#include "slab.h"
 
 struct devsw devsw[NDEV];
 struct {
-  struct spinlock lock;
-  struct file file[NFILE];
+  struct spinlock lock;  // protects every file's ref
+  struct slabcache cache;
 } ftable;
 
 void
 fileinit(void)
 {
   initlock(&ftable.lock, "ftable");
+  slabinit(&ftable.cache, "file", sizeof(struct file), 0);
 }
 
 // Allocate a file structure.
@@ -28,16 +31,11 @@ filealloc(void)
 {
   struct file *f;
 
-  acquire(&ftable.lock);
-  for(f = ftable.file; f < ftable.file + NFILE; f++){
-    if(f->ref == 0){
-      f->ref = 1;
-      release(&ftable.lock);
-      return f;
-    }
-  }
-  release(&ftable.lock);
-  return 0;
+  if((f = slaballoc(&ftable.cache)) == 0)
+    return 0;
+  memset(f, 0, sizeof(*f));
+  f->ref = 1;
+  return f;
 }
 
 // Increment ref count for file f.
@@ -69,6 +67,7 @@ fileclose(struct file *f)
   f->ref = 0;
   f->type = FD_NONE;
   release(&ftable.lock);
+  slabfree(&ftable.cache, f);
 
   if(ff.type == FD_PIPE)
     pipeclose(ff.pipe, ff.writable);
@@ -84,9 +83,9 @@ int
 filestat(struct file *f, struct stat *st)
 {
   if(f->type == FD_INODE){
-    ilock(f->ip);
+    ilockshared(f->ip);
     stati(f->ip, st);
-    iunlock(f->ip);
+    iunlockshared(f->ip);
     return 0;
   }
   return -1;
@@ -103,6 +102,19 @@ fileread(struct file *f, char *addr, int n)
   if(f->type == FD_PIPE)
     return piperead(f->pipe, addr, n);
   if(f->type == FD_INODE){
+    // Readers of a file can share its inode, unless they
+    // share this struct file and so its offset.  Devices
+    // such as the console drop and retake the lock.
+    if(f->ref == 1){
+      ilockshared(f->ip);
+      if(f->ip->type != T_DEV){
+        if((r = readi(f->ip, addr, f->off, n)) > 0)
+          f->off += r;
+        iunlockshared(f->ip);
+        return r;
+      }
+      iunlockshared(f->ip);
+    }
     ilock(f->ip);
     if((r = readi(f->ip, addr, f->off, n)) > 0)
       f->off += r;
@@ -124,25 +136,24 @@ filewrite(struct file *f, char *addr, int n)
   if(f->type == FD_PIPE)
     return pipewrite(f->pipe, addr, n);
   if(f->type == FD_INODE){
-    // write a few blocks at a time to avoid exceeding
-    // the maximum log transaction size, including
-    // i-node, indirect block, allocation blocks,
-    // and 2 blocks of slop for non-aligned writes.
+    // reserve log space in proportion to the write, so
+    // that a large write commits a few big transactions;
+    // only writes bigger than the whole log are split.
     // this really belongs lower down, since writei()
     // might be writing a device like the console.
-    int max = ((MAXOPBLOCKS-1-1-2) / 2) * 512;
+    int max = (LOGSIZE - 1 - WRITEBLOCKS(0)) * BSIZE;
     int i = 0;
     while(i < n){
       int n1 = n - i;
       if(n1 > max)
         n1 = max;
 
-      begin_op();
+      begin_opn(WRITEBLOCKS(n1));
       ilock(f->ip);
       if ((r = writei(f->ip, addr + i, f->off, n1)) > 0)
         f->off += r;
       iunlock(f->ip);
-      end_op();
+      end_opn(WRITEBLOCKS(n1));
 
       if(r < 0)
         break;
@@ -155,3 +166,83 @@ filewrite(struct file *f, char *addr, int n)
   panic("filewrite");
 }
 
+
+// Copy one run of at most n bytes from pipe pin to pipe pout.
+// The two busy flags are taken lower pipe first, so splices
+// running in opposite directions cannot each hold one and
+// wait forever for the other.  Returns bytes moved, 0 or -1.
+static int
+splicepipes(struct pipe *pin, struct pipe *pout, int n, int wait)
+{
+  char *src, *dst;
+  int m;
+
+  if(pin < pout){
+    if((m = pipebeginread(pin, &src, n, wait)) <= 0)
+      return m;
+    if((n = pipebeginwrite(pout, &dst, m)) < 0){
+      pipeendread(pin, 0);
+      return -1;
+    }
+  } else {
+    if((n = pipebeginwrite(pout, &dst, n)) < 0)
+      return -1;
+    if((m = pipebeginread(pin, &src, n, wait)) <= 0){
+      pipeendwrite(pout, 0);
+      return m;
+    }
+  }
+  if(m > n)
+    m = n;
+  memmove(dst, src, m);
+  pipeendwrite(pout, m);
+  pipeendread(pin, m);
+  return m;
+}
+
+// Move up to n bytes from fin to fout without a user buffer.
+// One of them must be a pipe: bytes go straight between the
+// pipe's ring and the buffer cache, or from ring to ring.
+// Like read(), only the first run waits for a pipe to fill.
+int
+filesplice(struct file *fin, struct file *fout, int n)
+{
+  char *addr;
+  int m, r, tot;
+
+  if(fin->readable == 0 || fout->writable == 0 || n < 0)
+    return -1;
+  if(fin->type != FD_PIPE && fout->type != FD_PIPE)
+    return -1;
+  if(fin->type == FD_PIPE && fout->type == FD_PIPE && fin->pipe == fout->pipe)
+    return -1;
+
+  tot = 0;
+  while(tot < n){
+    if(fin->type == FD_PIPE && fout->type == FD_PIPE){
+      if((r = splicepipes(fin->pipe, fout->pipe, n - tot, tot == 0)) <= 0)
+        return tot ? tot : r;
+      m = r;
+    } else if(fin->type == FD_PIPE){
+      if((m = pipebeginread(fin->pipe, &addr, n - tot, tot == 0)) <= 0)
+        return tot ? tot : m;
+      r = filewrite(fout, addr, m);
+      pipeendread(fin->pipe, r > 0 ? r : 0);
+    } else if(fin->type == FD_INODE){
+      if((m = pipebeginwrite(fout->pipe, &addr, n - tot)) < 0)
+        return tot ? tot : -1;
+      ilock(fin->ip);
+      if((r = readi(fin->ip, addr, fin->off, m)) > 0)
+        fin->off += r;
+      iunlock(fin->ip);
+      pipeendwrite(fout->pipe, r > 0 ? r : 0);
+    } else
+      panic("filesplice");
+    if(r < 0)
+      return tot ? tot : -1;
+    tot += r;
+    if(r < m)
+      break;  // end of file
+  }
+  return tot;
+}
@@ -14,6 +14,8 @@ struct inode {
   uint dev;           // Device number
   uint inum;          // Inode number
   int ref;            // Reference count
+  struct inode *next; // in icache, with ref, dev and inum
+  struct inode **pprev;
   struct sleeplock lock; // protects everything below here
   int valid;          // inode has been read from disk?
 
@@ -28,10 +30,10 @@ struct inode {
 // table mapping major device number to
 // device functions
 struct devsw {
-  int (*read)(struct inode*, char*, int);
+  int (*read)(struct inode*, char*, uint, int);
   int (*write)(struct inode*, char*, int);
 };
 
 extern struct devsw devsw[];
 
-#define CONSOLE 1
+#include "dev.h"
@@ -15,10 +15,7 @@ int main()
         }
         if (p == 0)
         {
-            for(int i = 0 ; i < 20000 * 30 ; i++)
-            {
-                delay(2000000000);
-            }
+            delay(300);
             exit();
         }
         
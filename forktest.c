@@ -1,11 +1,12 @@
 // Test that fork fails gracefully.
-// Tiny executable so that the limit can be filling the proc table.
+// Tiny executable so that the limit is as many processes as
+// memory can hold.
 
 #include "types.h"
 #include "stat.h"
 #include "user.h"
 
-#define N  1000
+#define N  100000
 
 void
 printf(int fd, const char *s, ...)
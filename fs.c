@@ -20,6 +20,7 @@
 #include "fs.h"
 #include "buf.h"
 #include "file.h"
+#include "slab.h"
 
 #define min(a, b) ((a) < (b) ? (a) : (b))
 static void itrunc(struct inode*);
@@ -52,31 +53,57 @@ bzero(int dev, int bno)
 
 // Blocks.
 
-// Allocate a zeroed disk block.
+// Allocate a run of at most n free blocks, searching from
+// block goal onwards and wrapping around.  The run is the
+// first free block found plus the free blocks that follow
+// it within the same bitmap block, so it costs a single
+// bitmap update.  Sets *start and returns the run length.
+// The blocks are not zeroed.
 static uint
-balloc(uint dev)
+ballocrun(uint dev, uint goal, uint n, uint *start)
 {
-  int b, bi, m;
+  uint i, b, bi, len;
+  int m;
   struct buf *bp;
 
+  if(goal >= sb.size)
+    goal = 0;
   bp = 0;
-  for(b = 0; b < sb.size; b += BPB){
-    bp = bread(dev, BBLOCK(b, sb));
-    for(bi = 0; bi < BPB && b + bi < sb.size; bi++){
-      m = 1 << (bi % 8);
-      if((bp->data[bi/8] & m) == 0){  // Is block free?
-        bp->data[bi/8] |= m;  // Mark block in use.
-        log_write(bp);
+  for(i = 0; i < sb.size; i++){
+    b = (goal + i) % sb.size;
+    if(bp == 0 || bp->blockno != BBLOCK(b, sb)){
+      if(bp)
         brelse(bp);
-        bzero(dev, b + bi);
-        return b + bi;
-      }
+      bp = bread(dev, BBLOCK(b, sb));
     }
+    bi = b % BPB;
+    if((bp->data[bi/8] & (1 << (bi % 8))) != 0)
+      continue;
+    for(len = 0; len < n && bi + len < BPB && b + len < sb.size; len++){
+      m = 1 << ((bi + len) % 8);
+      if((bp->data[(bi + len)/8] & m) != 0)  // Is block in use?
+        break;
+      bp->data[(bi + len)/8] |= m;  // Mark block in use.
+    }
+    log_write(bp);
     brelse(bp);
+    *start = b;
+    return len;
   }
   panic("balloc: out of blocks");
 }
 
+// Allocate a zeroed disk block.
+static uint
+balloc(uint dev)
+{
+  uint b;
+
+  ballocrun(dev, 0, 1, &b);
+  bzero(dev, b);
+  return b;
+}
+
 // Free a disk block.
 static void
 bfree(int dev, uint b)
@@ -120,17 +147,17 @@ bfree(int dev, uint b)
 //   the reference and link counts have fallen to zero.
 //
 // * Referencing in cache: an entry in the inode cache
-//   is free if ip->ref is zero. Otherwise ip->ref tracks
+//   exists while ip->ref is non-zero, and ip->ref tracks
 //   the number of in-memory pointers to the entry (open
 //   files and current directories). iget() finds or
-//   creates a cache entry and increments its ref; iput()
-//   decrements ref.
+//   allocates an entry and increments its ref; iput()
+//   decrements ref, and frees the entry at zero.
 //
 // * Valid: the information (type, size, &c) in an inode
 //   cache entry is only correct when ip->valid is 1.
 //   ilock() reads the inode from
-//   the disk and sets ip->valid, while iput() clears
-//   ip->valid if ip->ref has fallen to zero.
+//   the disk and sets ip->valid, and a new entry starts
+//   with ip->valid clear.
 //
 // * Locked: file system code may only examine and modify
 //   the information in an inode and its content if it
@@ -154,10 +181,11 @@ bfree(int dev, uint b)
 // have locked the inodes involved; this lets callers create
 // multi-step atomic operations.
 //
-// The icache.lock spin-lock protects the allocation of icache
-// entries. Since ip->ref indicates whether an entry is free,
+// The icache.lock spin-lock protects the list of icache
+// entries. Since ip->ref decides when an entry is freed,
 // and ip->dev and ip->inum indicate which i-node an entry
 // holds, one must hold icache.lock while using any of those fields.
+// Entries come from a slab cache, so there is no fixed limit.
 //
 // An ip->lock sleep-lock protects all ip-> fields other than ref,
 // dev, and inum.  One must hold ip->lock in order to
@@ -165,18 +193,21 @@ bfree(int dev, uint b)
 
 struct {
   struct spinlock lock;
-  struct inode inode[NINODE];
+  struct inode *head;       // inodes with ref > 0
+  struct slabcache cache;
 } icache;
 
+static void
+inodector(void *p)
+{
+  initsleeplock(&((struct inode*)p)->lock, "inode");
+}
+
 void
 iinit(int dev)
 {
-  int i = 0;
-  
   initlock(&icache.lock, "icache");
-  for(i = 0; i < NINODE; i++) {
-    initsleeplock(&icache.inode[i].lock, "inode");
-  }
+  slabinit(&icache.cache, "inode", sizeof(struct inode), inodector);
 
   readsb(dev, &sb);
   cprintf("sb: size %d nblocks %d ninodes %d nlog %d logstart %d\
@@ -241,31 +272,30 @@ iupdate(struct inode *ip)
 static struct inode*
 iget(uint dev, uint inum)
 {
-  struct inode *ip, *empty;
+  struct inode *ip;
 
   acquire(&icache.lock);
 
-  // Is the inode already cached?
-  empty = 0;
-  for(ip = &icache.inode[0]; ip < &icache.inode[NINODE]; ip++){
-    if(ip->ref > 0 && ip->dev == dev && ip->inum == inum){
+  // Is the inode already in memory?
+  for(ip = icache.head; ip != 0; ip = ip->next){
+    if(ip->dev == dev && ip->inum == inum){
       ip->ref++;
       release(&icache.lock);
       return ip;
     }
-    if(empty == 0 && ip->ref == 0)    // Remember empty slot.
-      empty = ip;
   }
 
-  // Recycle an inode cache entry.
-  if(empty == 0)
+  if((ip = slaballoc(&icache.cache)) == 0)
     panic("iget: no inodes");
-
-  ip = empty;
   ip->dev = dev;
   ip->inum = inum;
   ip->ref = 1;
   ip->valid = 0;
+  ip->next = icache.head;
+  if(icache.head)
+    icache.head->pprev = &ip->next;
+  ip->pprev = &icache.head;
+  icache.head = ip;
   release(&icache.lock);
 
   return ip;
@@ -321,6 +351,33 @@ iunlock(struct inode *ip)
   releasesleep(&ip->lock);
 }
 
+// Lock the given inode shared with other readers, for
+// paths that only read it, such as readi() or stati().
+// Reading the inode from disk needs the exclusive lock.
+void
+ilockshared(struct inode *ip)
+{
+  if(ip == 0 || ip->ref < 1)
+    panic("ilockshared");
+
+  acquiresleepshared(&ip->lock);
+  while(ip->valid == 0){
+    releasesleepshared(&ip->lock);
+    ilock(ip);
+    iunlock(ip);
+    acquiresleepshared(&ip->lock);
+  }
+}
+
+void
+iunlockshared(struct inode *ip)
+{
+  if(ip == 0 || ip->ref < 1)
+    panic("iunlockshared");
+
+  releasesleepshared(&ip->lock);
+}
+
 // Drop a reference to an in-memory inode.
 // If that was the last reference, the inode cache entry can
 // be recycled.
@@ -347,8 +404,15 @@ iput(struct inode *ip)
   releasesleep(&ip->lock);
 
   acquire(&icache.lock);
-  ip->ref--;
+  if(--ip->ref > 0){
+    release(&icache.lock);
+    return;
+  }
+  *ip->pprev = ip->next;
+  if(ip->next)
+    ip->next->pprev = ip->pprev;
   release(&icache.lock);
+  slabfree(&icache.cache, ip);
 }
 
 // Common idiom: unlock, then put.
@@ -399,6 +463,44 @@ bmap(struct inode *ip, uint bn)
   panic("bmap: out of range");
 }
 
+// Allocate file blocks bn up to last of ip, which lie
+// past the end of the file, right after the file's last
+// block and in as few contiguous runs as the free bitmap
+// allows.  The new blocks are not zeroed; writei()
+// overwrites them with bnew().
+static void
+bmapappend(struct inode *ip, uint bn, uint last)
+{
+  uint start, len, i, *a;
+  struct buf *bp;
+
+  if(last >= NDIRECT && ip->addrs[NDIRECT] == 0)
+    ip->addrs[NDIRECT] = balloc(ip->dev);
+
+  start = bn > 0 ? bmap(ip, bn - 1) + 1 : 0;
+  while(bn <= last){
+    len = ballocrun(ip->dev, start, last - bn + 1, &start);
+    for(i = 0; i < len && bn + i < NDIRECT; i++){
+      if(ip->addrs[bn + i] != 0)
+        panic("bmapappend");
+      ip->addrs[bn + i] = start + i;
+    }
+    if(i < len){
+      bp = bread(ip->dev, ip->addrs[NDIRECT]);
+      a = (uint*)bp->data;
+      for(; i < len; i++){
+        if(a[bn + i - NDIRECT] != 0)
+          panic("bmapappend");
+        a[bn + i - NDIRECT] = start + i;
+      }
+      log_write(bp);
+      brelse(bp);
+    }
+    bn += len;
+    start += len;
+  }
+}
+
 // Truncate inode (discard contents).
 // Only called when the inode has no links
 // to it (no directory entries referring to it)
@@ -458,7 +560,7 @@ readi(struct inode *ip, char *dst, uint off, uint n)
   if(ip->type == T_DEV){
     if(ip->major < 0 || ip->major >= NDEV || !devsw[ip->major].read)
       return -1;
-    return devsw[ip->major].read(ip, dst, n);
+    return devsw[ip->major].read(ip, dst, off, n);
   }
 
   if(off > ip->size || off + n < off)
@@ -481,7 +583,7 @@ readi(struct inode *ip, char *dst, uint off, uint n)
 int
 writei(struct inode *ip, char *src, uint off, uint n)
 {
-  uint tot, m;
+  uint tot, m, fresh;
   struct buf *bp;
 
   if(ip->type == T_DEV){
@@ -495,8 +597,17 @@ writei(struct inode *ip, char *src, uint off, uint n)
   if(off + n > MAXFILE*BSIZE)
     return -1;
 
+  // Blocks from fresh onwards are past the old end of file.
+  // Allocate them together, and skip reading them from disk.
+  fresh = (ip->size + BSIZE - 1) / BSIZE;
+  if(n > 0 && (off + n - 1)/BSIZE >= fresh)
+    bmapappend(ip, fresh, (off + n - 1)/BSIZE);
+
   for(tot=0; tot<n; tot+=m, off+=m, src+=m){
-    bp = bread(ip->dev, bmap(ip, off/BSIZE));
+    if(off/BSIZE >= fresh)
+      bp = bnew(ip->dev, bmap(ip, off/BSIZE));
+    else
+      bp = bread(ip->dev, bmap(ip, off/BSIZE));
     m = min(n - tot, BSIZE - off%BSIZE);
     memmove(bp->data + off%BSIZE, src, m);
     log_write(bp);
@@ -632,21 +743,26 @@ namex(char *path, int nameiparent, char *name)
     ip = idup(myproc()->cwd);
 
   while((path = skipelem(path, name)) != 0){
-    ilock(ip);
+    // Lookups only read directories, so concurrent
+    // lookups through the same directory can share it.
+    ilockshared(ip);
     if(ip->type != T_DIR){
-      iunlockput(ip);
+      iunlockshared(ip);
+      iput(ip);
       return 0;
     }
     if(nameiparent && *path == '\0'){
       // Stop one level early.
-      iunlock(ip);
+      iunlockshared(ip);
       return ip;
     }
     if((next = dirlookup(ip, name, 0)) == 0){
-      iunlockput(ip);
+      iunlockshared(ip);
+      iput(ip);
       return 0;
     }
-    iunlockput(ip);
+    iunlockshared(ip);
+    iput(ip);
     ip = next;
   }
   if(nameiparent){
@@ -44,6 +44,11 @@ struct dinode {
 // Bitmap bits per block
 #define BPB           (BSIZE*8)
 
+// Most distinct blocks a write of n bytes to one inode can
+// log: the data blocks plus 2 for unaligned ends, the inode,
+// the indirect block and every bitmap block.
+#define WRITEBLOCKS(n) ((n)/BSIZE + 2 + 1 + 1 + FSSIZE/BPB + 1)
+
 // Block of free map containing bit for block b
 #define BBLOCK(b, sb) (b/BPB + sb.bmapstart)
 
@@ -1,15 +1,25 @@
+// getancestors [pid]: list the ancestors of a process, by
+// default this one, parent first.
+
 #include "types.h"
 #include "user.h"
-#include "fcntl.h"
+#include "procinfo.h"
+
+#define N 64
 
-int main()
+struct procinfo buf[N];
+
+int
+main(int argc, char *argv[])
 {
-    int p1 = fork();
-    if(p1<0) exit();
-    else if(p1 == 0) {
-        get_ancestors(getpid());
-    }
-    else
-        wait();
+  int pid, i, n;
+
+  pid = argc > 1 ? atoi(argv[1]) : ugetpid();
+  if((n = get_ancestors(pid, buf, N)) < 0){
+    printf(2, "getancestors: no process %d\n", pid);
     exit();
+  }
+  for(i = 0; i < n; i++)
+    printf(1, "%d parent %d created %d\n", buf[i].pid, buf[i].ppid, buf[i].ctime);
+  exit();
 }
@@ -1,15 +1,28 @@
+// getdescendant [pid]: list the descendants of a process,
+// by default init, indented by generation.
+
 #include "types.h"
 #include "user.h"
-#include "fcntl.h"
+#include "procinfo.h"
+
+#define N 256
 
-int main()
+struct procinfo buf[N];
+
+int
+main(int argc, char *argv[])
 {
-    int p1 = fork();
-    if(p1<0) exit();
-    else if(p1 == 0) {
-        get_descendant(1);
-    }
-    else
-        wait();
+  int pid, i, j, n;
+
+  pid = argc > 1 ? atoi(argv[1]) : 1;
+  if((n = get_descendant(pid, buf, N)) < 0){
+    printf(2, "getdescendant: no process %d\n", pid);
     exit();
+  }
+  for(i = 0; i < n; i++){
+    for(j = 1; j < buf[i].depth; j++)
+      printf(1, "  ");
+    printf(1, "%d parent %d created %d\n", buf[i].pid, buf[i].ppid, buf[i].ctime);
+  }
+  exit();
 }
@@ -12,6 +12,7 @@
 #include "sleeplock.h"
 #include "fs.h"
 #include "buf.h"
+#include "trace.h"
 
 #define SECTOR_SIZE   512
 #define IDE_BSY       0x80
@@ -118,6 +119,8 @@ ideintr(void)
   if(!(b->flags & B_DIRTY) && idewait(1) >= 0)
     insl(0x1f0, b->data, BSIZE/4);
 
+  trace(TR_DISKDONE, b->blockno, 0);
+
   // Wake process waiting for this buf.
   b->flags |= B_VALID;
   b->flags &= ~B_DIRTY;
@@ -147,6 +150,7 @@ iderw(struct buf *b)
     panic("iderw: ide disk 1 not present");
 
   acquire(&idelock);  //DOC:acquire-lock
+  trace(TR_DISKREQ, b->blockno, (b->flags & B_DIRTY) != 0);
 
   // Append b to idequeue.
   b->qnext = 0;
@@ -0,0 +1,250 @@
+// Run a command and print the kernel trace events recorded
+// while it ran.
+// usage: ktrace [-h] cmd [args...]
+//   -h  print histograms of run, system call and disk times
+//       instead of the timeline
+// Times are in microseconds.
+
+#include "types.h"
+#include "user.h"
+#include "memlayout.h"
+#include "date.h"
+#include "trace.h"
+
+#define MAXEV  (8*4096)
+#define NSLOT  64      // pending start events kept for pairing
+#define NBUCKET 20     // histogram buckets, powers of 2 in us
+
+struct trevent *ev, *tmp;
+int nev;
+
+char *names[] = {
+[TR_RUN]        "run",
+[TR_STOP]       "stop",
+[TR_WAKEUP]     "wakeup",
+[TR_AGING]      "aging",
+[TR_DISKREQ]    "diskreq",
+[TR_DISKDONE]   "diskdone",
+[TR_BEGINOP]    "beginop",
+[TR_COMMIT]     "commit",
+[TR_COMMITDONE] "commitdone",
+[TR_SYSCALL]    "syscall",
+[TR_SYSRET]     "sysret",
+[TR_LOST]       "lost",
+};
+
+// Microseconds in cyc TSC cycles, using the time page's
+// conversion factor.
+uint
+cyc2us(uint64 cyc)
+{
+  struct timepage *tp = (struct timepage*)TIMEPAGE;
+  uint64 ns;
+  uint us, rem;
+
+  ns = ((cyc >> 32) * tp->mult << (32 - tp->shift)) +
+       ((uint64)(uint)cyc * tp->mult >> tp->shift);
+  asm("divl %4" : "=a" (us), "=d" (rem) :
+      "a" ((uint)ns), "d" ((uint)(ns >> 32)), "rm" (1000));
+  return us;
+}
+
+// Sort ev[lo, hi) by time.
+void
+sort(int lo, int hi)
+{
+  int mid, i, j, k;
+
+  if(hi - lo < 2)
+    return;
+  mid = (lo + hi) / 2;
+  sort(lo, mid);
+  sort(mid, hi);
+  i = lo;
+  j = mid;
+  for(k = lo; k < hi; k++){
+    if(j >= hi || (i < mid && ev[i].tsc <= ev[j].tsc))
+      tmp[k] = ev[i++];
+    else
+      tmp[k] = ev[j++];
+  }
+  memmove(ev + lo, tmp + lo, (hi - lo) * sizeof(*ev));
+}
+
+void
+timeline(void)
+{
+  struct trevent *e;
+
+  printf(1, "      us cpu  pid event\n");
+  for(e = ev; e < ev + nev; e++){
+    printf(1, "%d\t%d %d\t%s", cyc2us(e->tsc - ev[0].tsc),
+           e->cpu, e->pid, names[e->type]);
+    switch(e->type){
+    case TR_RUN:
+      printf(1, " queue %d", e->a);
+      break;
+    case TR_STOP:
+      printf(1, " state %d", e->a);
+      break;
+    case TR_WAKEUP:
+    case TR_AGING:
+      printf(1, " pid %d queue %d", e->a, e->b);
+      break;
+    case TR_DISKREQ:
+      printf(1, " block %d %s", e->a, e->b ? "write" : "read");
+      break;
+    case TR_DISKDONE:
+      printf(1, " block %d", e->a);
+      break;
+    case TR_BEGINOP:
+      printf(1, " reserved %d outstanding %d", e->a, e->b);
+      break;
+    case TR_COMMIT:
+      printf(1, " blocks %d", e->a);
+      break;
+    case TR_SYSCALL:
+      printf(1, " %d", e->a);
+      break;
+    case TR_SYSRET:
+      printf(1, " %d = %d", e->a, e->b);
+      break;
+    case TR_LOST:
+      printf(1, " %d events", e->a);
+      break;
+    }
+    printf(1, "\n");
+  }
+}
+
+// Times between a start event and the next end event with
+// the same key.
+struct hist {
+  char *name;
+  int start, end;
+  uint key[NSLOT];
+  uint64 tsc[NSLOT];
+  int used[NSLOT];
+  uint count[NBUCKET];
+};
+
+struct hist hists[] = {
+  { "run",     TR_RUN,     TR_STOP },
+  { "syscall", TR_SYSCALL, TR_SYSRET },
+  { "disk",    TR_DISKREQ, TR_DISKDONE },
+};
+
+#define NHIST (sizeof(hists)/sizeof(hists[0]))
+
+uint
+evkey(struct trevent *e)
+{
+  switch(e->type){
+  case TR_RUN:
+  case TR_STOP:
+    return e->cpu;
+  case TR_DISKREQ:
+  case TR_DISKDONE:
+    return e->a;
+  }
+  return e->pid;
+}
+
+void
+histadd(struct hist *h, struct trevent *e)
+{
+  uint key, us;
+  int i, b;
+
+  key = evkey(e);
+  if(e->type == h->start){
+    for(i = 0; i < NSLOT; i++){
+      if(!h->used[i] || h->key[i] == key){
+        h->used[i] = 1;
+        h->key[i] = key;
+        h->tsc[i] = e->tsc;
+        return;
+      }
+    }
+    return;
+  }
+  for(i = 0; i < NSLOT; i++){
+    if(h->used[i] && h->key[i] == key){
+      h->used[i] = 0;
+      us = cyc2us(e->tsc - h->tsc[i]);
+      for(b = 0; b < NBUCKET-1 && us >= (1 << b); b++)
+        ;
+      h->count[b]++;
+      return;
+    }
+  }
+}
+
+void
+histograms(void)
+{
+  struct trevent *e;
+  struct hist *h;
+  int b;
+
+  for(e = ev; e < ev + nev; e++)
+    for(h = hists; h < hists + NHIST; h++)
+      if(e->type == h->start || e->type == h->end)
+        histadd(h, e);
+
+  for(h = hists; h < hists + NHIST; h++){
+    printf(1, "%s:\n", h->name);
+    for(b = 0; b < NBUCKET; b++)
+      if(h->count[b])
+        printf(1, "  < %d us\t%d\n", 1 << b, h->count[b]);
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  int hflag, n, pid;
+
+  hflag = 0;
+  if(argc > 1 && strcmp(argv[1], "-h") == 0){
+    hflag = 1;
+    argc--;
+    argv++;
+  }
+  if(argc < 2){
+    printf(2, "usage: ktrace [-h] cmd [args...]\n");
+    exit();
+  }
+  ev = malloc(MAXEV * sizeof(*ev));
+  tmp = malloc(MAXEV * sizeof(*ev));
+  if(ev == 0 || tmp == 0){
+    printf(2, "ktrace: out of memory\n");
+    exit();
+  }
+
+  // Throw away the events recorded so far.
+  while(tracedrain(ev, MAXEV) > 0)
+    ;
+
+  pid = fork();
+  if(pid < 0){
+    printf(2, "ktrace: fork failed\n");
+    exit();
+  }
+  if(pid == 0){
+    exec(argv[1], argv + 1);
+    printf(2, "ktrace: exec %s failed\n", argv[1]);
+    exit();
+  }
+  wait();
+
+  while(nev < MAXEV && (n = tracedrain(ev + nev, MAXEV - nev)) > 0)
+    nev += n;
+  sort(0, nev);
+
+  if(hflag)
+    histograms();
+  else
+    timeline();
+  exit();
+}
@@ -0,0 +1,102 @@
+// Print kernel lock contention, read from the lockstat
+// device, as a table ranked by total wait time.
+// usage: lockprof [-r] [-a]
+//   -r  reset the counters
+//   -a  also list locks that were never contended
+// Times are in units of 1024 TSC cycles.
+
+#include "types.h"
+#include "user.h"
+#include "fcntl.h"
+#include "lockstat.h"
+
+#define NLS 64
+
+struct lockstat ls[NLS];
+
+// Print v right-aligned in w columns.
+void
+printd(uint v, int w)
+{
+  uint t;
+  int n;
+
+  for(n = 1, t = v; t >= 10; t /= 10)
+    n++;
+  for(; w > n; w--)
+    printf(1, " ");
+  printf(1, "%d", v);
+}
+
+// Print a cycle count in units of 1024 cycles.
+void
+printcyc(uint64 x, int w)
+{
+  printd((uint)(x >> 10), w);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int fd, n, i, j, all;
+  struct lockstat t;
+  char *name;
+
+  all = 0;
+  for(i = 1; i < argc; i++){
+    if(strcmp(argv[i], "-r") == 0){
+      if((fd = open("lockstat", O_WRONLY)) < 0 || write(fd, "reset", 5) != 5){
+        printf(2, "lockprof: reset failed\n");
+        exit();
+      }
+      close(fd);
+      exit();
+    } else if(strcmp(argv[i], "-a") == 0)
+      all = 1;
+    else {
+      printf(2, "usage: lockprof [-r] [-a]\n");
+      exit();
+    }
+  }
+
+  if((fd = open("lockstat", O_RDONLY)) < 0){
+    printf(2, "lockprof: cannot open lockstat\n");
+    exit();
+  }
+  n = read(fd, ls, sizeof(ls)) / sizeof(ls[0]);
+  close(fd);
+
+  // Rank by total wait time.
+  for(i = 1; i < n; i++){
+    t = ls[i];
+    for(j = i; j > 0 && ls[j-1].wait < t.wait; j--)
+      ls[j] = ls[j-1];
+    ls[j] = t;
+  }
+
+  printf(1, "name             type    acquire  contend     wait  maxwait     hold  maxhold\n");
+  for(i = 0; i < n; i++){
+    if(ls[i].ncontend == 0 && !all)
+      continue;
+    name = ls[i].name;
+    printf(1, "%s", name);
+    for(j = strlen(name); j < LSNAMELEN + 1; j++)
+      printf(1, " ");
+    printf(1, "%s", ls[i].type == LS_SLEEP ? "sleep" : "spin ");
+    printd(ls[i].nacquire, 10);
+    printd(ls[i].ncontend, 9);
+    printcyc(ls[i].wait, 9);
+    printcyc(ls[i].maxwait, 9);
+    printcyc(ls[i].hold, 9);
+    printcyc(ls[i].maxhold, 9);
+    printf(1, "\n");
+    for(j = 0; j < LSSITES; j++){
+      if(ls[i].site[j].ncontend == 0)
+        continue;
+      printf(1, "    at %x: %d waits, ", ls[i].site[j].pc, ls[i].site[j].ncontend);
+      printcyc(ls[i].site[j].wait, 0);
+      printf(1, "\n");
+    }
+  }
+  exit();
+}
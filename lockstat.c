@@ -0,0 +1,220 @@
+// Lock profiling.
+//
+// Locks with the same name and type share a lock class.
+// Each class keeps per-CPU counters, which are only updated
+// with interrupts off, so no lock protects them.  Reading
+// the LOCKSTAT device returns one struct lockstat per class,
+// summed over the CPUs; writing "reset" to it clears them.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "x86.h"
+#include "mmu.h"
+#include "proc.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "file.h"
+#include "lockstat.h"
+
+#define NLOCKCLASS 64
+
+struct lockclass {
+  char *name;
+  int type;
+  struct lockcpu {
+    uint nacquire;
+    uint ncontend;
+    uint64 wait;
+    uint64 maxwait;
+    uint64 hold;
+    uint64 maxhold;
+    struct lssite site[LSSITES];
+  } cpu[NCPU];
+};
+
+static struct lockclass classes[NLOCKCLASS];
+static uint nclass;
+static uint classlock;  // serializes additions to classes[]
+
+static struct lockclass*
+findclass(char *name, int type, uint n)
+{
+  struct lockclass *c;
+
+  for(c = classes; c < &classes[n]; c++)
+    if(c->type == type && (c->name == name || strncmp(c->name, name, LSNAMELEN) == 0))
+      return c;
+  return 0;
+}
+
+// Return the class of locks called name, adding it if
+// needed.  Returns 0 if the table is full, in which case
+// the lock is not profiled.  Called from initlock(), maybe
+// before mycpu() works, so it masks interrupts itself.
+struct lockclass*
+lockclass(char *name, int type)
+{
+  struct lockclass *c;
+  uint eflags;
+
+  if((c = findclass(name, type, nclass)) != 0)
+    return c;
+
+  eflags = readeflags();
+  cli();
+  while(xchg(&classlock, 1) != 0)
+    ;
+  if((c = findclass(name, type, nclass)) == 0 && nclass < NLOCKCLASS){
+    c = &classes[nclass];
+    c->name = name;
+    c->type = type;
+    __sync_synchronize();
+    nclass++;
+  }
+  xchg(&classlock, 0);
+  if(eflags & FL_IF)
+    sti();
+  return c;
+}
+
+// Record an acquisition of a lock of class c from pc,
+// after waiting wait cycles.  Interrupts must be off.
+void
+lockstatacquire(struct lockclass *c, uint pc, int contended, uint64 wait)
+{
+  struct lockcpu *lc;
+  struct lssite *s, *min;
+
+  if(c == 0)
+    return;
+  lc = &c->cpu[mycpu() - cpus];
+  lc->nacquire++;
+  if(!contended)
+    return;
+  lc->ncontend++;
+  lc->wait += wait;
+  if(wait > lc->maxwait)
+    lc->maxwait = wait;
+
+  // Keep the sites that waited longest, replacing the
+  // one with the least waiting when pc is new.
+  min = lc->site;
+  for(s = lc->site; s < &lc->site[LSSITES]; s++){
+    if(s->pc == pc)
+      break;
+    if(s->wait < min->wait)
+      min = s;
+  }
+  if(s == &lc->site[LSSITES]){
+    s = min;
+    s->pc = pc;
+    s->ncontend = 0;
+    s->wait = 0;
+  }
+  s->ncontend++;
+  s->wait += wait;
+}
+
+// Record that a lock of class c was held for hold cycles.
+// Interrupts must be off.
+void
+lockstatrelease(struct lockclass *c, uint64 hold)
+{
+  struct lockcpu *lc;
+
+  if(c == 0)
+    return;
+  lc = &c->cpu[mycpu() - cpus];
+  lc->hold += hold;
+  if(hold > lc->maxhold)
+    lc->maxhold = hold;
+}
+
+// Add the sites of lc to the LSSITES longest waiting
+// sites in ls, merging those with the same pc.
+static void
+mergesites(struct lockstat *ls, struct lockcpu *lc)
+{
+  struct lssite *s, *t, *min;
+
+  for(s = lc->site; s < &lc->site[LSSITES]; s++){
+    if(s->ncontend == 0)
+      continue;
+    min = ls->site;
+    for(t = ls->site; t < &ls->site[LSSITES]; t++){
+      if(t->pc == s->pc)
+        break;
+      if(t->wait < min->wait)
+        min = t;
+    }
+    if(t < &ls->site[LSSITES]){
+      t->ncontend += s->ncontend;
+      t->wait += s->wait;
+    } else if(s->wait > min->wait || min->ncontend == 0)
+      *min = *s;
+  }
+}
+
+// Fill ls with the counters of c summed over all CPUs.
+static void
+summarize(struct lockclass *c, struct lockstat *ls)
+{
+  struct lockcpu *lc;
+
+  memset(ls, 0, sizeof(*ls));
+  safestrcpy(ls->name, c->name, LSNAMELEN);
+  ls->type = c->type;
+  for(lc = c->cpu; lc < &c->cpu[NCPU]; lc++){
+    ls->nacquire += lc->nacquire;
+    ls->ncontend += lc->ncontend;
+    ls->wait += lc->wait;
+    ls->hold += lc->hold;
+    if(lc->maxwait > ls->maxwait)
+      ls->maxwait = lc->maxwait;
+    if(lc->maxhold > ls->maxhold)
+      ls->maxhold = lc->maxhold;
+    mergesites(ls, lc);
+  }
+}
+
+// Read whole struct lockstat records, starting with
+// record number off/sizeof(struct lockstat).
+static int
+lockstatread(struct inode *ip, char *dst, uint off, int n)
+{
+  struct lockstat ls;
+  uint i;
+  int tot;
+
+  if(off % sizeof(ls) != 0)
+    return -1;
+  tot = 0;
+  for(i = off / sizeof(ls); i < nclass && tot + sizeof(ls) <= n; i++){
+    summarize(&classes[i], &ls);
+    memmove(dst + tot, &ls, sizeof(ls));
+    tot += sizeof(ls);
+  }
+  return tot;
+}
+
+// The only command is "reset", which clears all counters.
+static int
+lockstatwrite(struct inode *ip, char *buf, int n)
+{
+  uint i;
+
+  if(n < 5 || strncmp(buf, "reset", 5) != 0)
+    return -1;
+  for(i = 0; i < nclass; i++)
+    memset(classes[i].cpu, 0, sizeof(classes[i].cpu));
+  return n;
+}
+
+void
+lockstatinit(void)
+{
+  devsw[LOCKSTAT].read = lockstatread;
+  devsw[LOCKSTAT].write = lockstatwrite;
+}
@@ -0,0 +1,28 @@
+// Lock profiling records, read from the LOCKSTAT device.
+// Times are in TSC cycles.
+
+#define LSNAMELEN 16  // bytes of lock name kept
+#define LSSITES   4   // call sites reported per lock class
+
+#define LS_SPIN   1   // spinlock
+#define LS_SLEEP  2   // sleeplock
+
+// A call site that waited for a lock.
+struct lssite {
+  uint pc;           // return address of acquire
+  uint ncontend;     // contended acquisitions from pc
+  uint64 wait;       // cycles pc spent waiting
+};
+
+// All locks with the same name and type.
+struct lockstat {
+  char name[LSNAMELEN];
+  int type;          // LS_SPIN or LS_SLEEP
+  uint nacquire;     // acquisitions
+  uint ncontend;     // acquisitions that had to wait
+  uint64 wait;       // total cycles spent waiting
+  uint64 maxwait;    // longest single wait
+  uint64 hold;       // total cycles held
+  uint64 maxhold;    // longest single hold
+  struct lssite site[LSSITES];  // sites that waited longest
+};
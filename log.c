@@ -5,6 +5,7 @@
 #include "sleeplock.h"
 #include "fs.h"
 #include "buf.h"
+#include "trace.h"
 
 // Simple logging that allows concurrent FS system calls.
 //
@@ -19,6 +20,9 @@
 // the count of in-progress FS system calls and returns.
 // But if it thinks the log is close to running out, it
 // sleeps until the last outstanding end_op() commits.
+// begin_op() reserves MAXOPBLOCKS log blocks; a call that
+// knows it will write more, such as a large write(), can
+// reserve exactly what it needs with begin_opn()/end_opn().
 //
 // The log is a physical re-do log containing disk blocks.
 // The on-disk log format:
@@ -41,6 +45,7 @@ struct log {
   int start;
   int size;
   int outstanding; // how many FS sys calls are executing.
+  int reserved;    // log blocks reserved by those sys calls.
   int committing;  // in commit(), please wait.
   int dev;
   struct logheader lh;
@@ -121,34 +126,50 @@ recover_from_log(void)
   write_head(); // clear the log
 }
 
-// called at the start of each FS system call.
+// called at the start of an FS system call that will
+// write at most nblocks distinct blocks.
 void
-begin_op(void)
+begin_opn(int nblocks)
 {
+  // the header takes one of the log's blocks.
+  if(nblocks > LOGSIZE - 1)
+    panic("begin_opn: too many blocks");
+
   acquire(&log.lock);
   while(1){
     if(log.committing){
       sleep(&log, &log.lock);
-    } else if(log.lh.n + (log.outstanding+1)*MAXOPBLOCKS > LOGSIZE){
+    } else if(log.lh.n + log.reserved + nblocks > LOGSIZE - 1){
       // this op might exhaust log space; wait for commit.
       sleep(&log, &log.lock);
     } else {
       log.outstanding += 1;
+      log.reserved += nblocks;
+      trace(TR_BEGINOP, log.reserved, log.outstanding);
       release(&log.lock);
       break;
     }
   }
 }
 
-// called at the end of each FS system call.
-// commits if this was the last outstanding operation.
+// called at the start of each FS system call.
 void
-end_op(void)
+begin_op(void)
+{
+  begin_opn(MAXOPBLOCKS);
+}
+
+// called at the end of an FS system call started with
+// begin_opn(nblocks). commits if this was the last
+// outstanding operation.
+void
+end_opn(int nblocks)
 {
   int do_commit = 0;
 
   acquire(&log.lock);
   log.outstanding -= 1;
+  log.reserved -= nblocks;
   if(log.committing)
     panic("log.committing");
   if(log.outstanding == 0){
@@ -173,6 +194,13 @@ end_op(void)
   }
 }
 
+// called at the end of each FS system call.
+void
+end_op(void)
+{
+  end_opn(MAXOPBLOCKS);
+}
+
 // Copy modified blocks from cache to log.
 static void
 write_log(void)
@@ -193,11 +221,13 @@ static void
 commit()
 {
   if (log.lh.n > 0) {
+    trace(TR_COMMIT, log.lh.n, 0);
     write_log();     // Write modified blocks from cache to log
     write_head();    // Write header to disk -- the real commit
     install_trans(); // Now install writes to home locations
     log.lh.n = 0;
     write_head();    // Erase the transaction from the log
+    trace(TR_COMMITDONE, 0, 0);
   }
 }
 
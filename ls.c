@@ -2,6 +2,16 @@
 #include "stat.h"
 #include "user.h"
 #include "fs.h"
+#include "fcntl.h"
+#include "ring.h"
+
+// Directory entries are stat'ed BATCH at a time, with one
+// ring_enter() doing the open, fstat and close of each.
+#define BATCH 32
+
+char paths[BATCH][512];
+struct stat sts[BATCH];
+int ring;  // the system call ring is mapped
 
 char*
 fmtname(char *path)
@@ -22,11 +32,40 @@ fmtname(char *path)
   return buf;
 }
 
+// Stat and print the first n of paths.
+void
+lsbatch(int n)
+{
+  struct cqe o, s, c;
+  int i, ok;
+
+  if(ring){
+    for(i = 0; i < n; i++){
+      ringsubmit(RING_OPEN, 0, 0, paths[i], O_RDONLY, 0);
+      ringsubmit(RING_FSTAT, RING_LASTFD, 0, &sts[i], 0, 0);
+      ringsubmit(RING_CLOSE, RING_LASTFD, 0, 0, 0, 0);
+    }
+    ring_enter(3*n);
+  }
+  for(i = 0; i < n; i++){
+    if(ring)
+      ok = ringreap(&o) == 0 && ringreap(&s) == 0 &&
+           ringreap(&c) == 0 && s.res == 0;
+    else
+      ok = stat(paths[i], &sts[i]) == 0;
+    if(!ok){
+      printf(1, "ls: cannot stat %s\n", paths[i]);
+      continue;
+    }
+    printf(1, "%s %d %d %d\n", fmtname(paths[i]), sts[i].type, sts[i].ino, sts[i].size);
+  }
+}
+
 void
 ls(char *path)
 {
   char buf[512], *p;
-  int fd;
+  int fd, n;
   struct dirent de;
   struct stat st;
 
@@ -54,17 +93,19 @@ ls(char *path)
     strcpy(buf, path);
     p = buf+strlen(buf);
     *p++ = '/';
+    n = 0;
     while(read(fd, &de, sizeof(de)) == sizeof(de)){
       if(de.inum == 0)
         continue;
       memmove(p, de.name, DIRSIZ);
       p[DIRSIZ] = 0;
-      if(stat(buf, &st) < 0){
-        printf(1, "ls: cannot stat %s\n", buf);
-        continue;
+      strcpy(paths[n++], buf);
+      if(n == BATCH){
+        lsbatch(n);
+        n = 0;
       }
-      printf(1, "%s %d %d %d\n", fmtname(buf), st.type, st.ino, st.size);
     }
+    lsbatch(n);
     break;
   }
   close(fd);
@@ -75,6 +116,7 @@ main(int argc, char *argv[])
 {
   int i;
 
+  ring = ring_enter(0) == 0;
   if(argc < 2){
     ls(".");
     exit();
@@ -0,0 +1,86 @@
+// Allocator stress test: random malloc and free of mostly
+// small and some large blocks, checking that blocks keep
+// their contents.  Reports allocations per second and the
+// peak heap size.
+// usage: mallocbench [nops]
+
+#include "types.h"
+#include "user.h"
+#include "date.h"
+
+#define NSLOT 1000
+
+char *ptr[NSLOT];
+uint size[NSLOT];
+uint seed = 1;
+
+uint
+rand(void)
+{
+  seed = seed * 1103515245 + 12345;
+  return seed >> 8;
+}
+
+// A size, 1 in 8 times up to 16 KB, otherwise up to 256 bytes.
+uint
+randsize(void)
+{
+  uint r = rand();
+
+  if(r % 8 == 0)
+    return r / 8 % (16*1024);
+  return r / 8 % 256;
+}
+
+uint
+ms(struct timespec *t)
+{
+  return t->tv_sec * 1000 + t->tv_nsec / 1000000;
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct timespec start, end;
+  uint i, j, nops, nalloc, elapsed;
+  char *base, *brk, *peak;
+
+  nops = argc > 1 ? atoi(argv[1]) : 200000;
+  nalloc = 0;
+  base = peak = sbrk(0);
+
+  uclock_gettime(&start);
+  for(i = 0; i < nops; i++){
+    j = rand() % NSLOT;
+    if(ptr[j]){
+      if(size[j] > 0 && (ptr[j][0] != (char)j || ptr[j][size[j]-1] != (char)j)){
+        printf(2, "mallocbench: block %d corrupted\n", j);
+        exit();
+      }
+      free(ptr[j]);
+      ptr[j] = 0;
+      continue;
+    }
+    size[j] = randsize();
+    if((ptr[j] = malloc(size[j])) == 0){
+      printf(2, "mallocbench: out of memory\n");
+      exit();
+    }
+    nalloc++;
+    if(size[j] > 0){
+      ptr[j][0] = j;
+      ptr[j][size[j]-1] = j;
+    }
+    if((brk = sbrk(0)) > peak)
+      peak = brk;
+  }
+  uclock_gettime(&end);
+
+  elapsed = ms(&end) - ms(&start);
+  if(elapsed == 0)
+    elapsed = 1;
+  printf(1, "%d allocations in %d ms: %d per second\n",
+         nalloc, elapsed, nalloc / elapsed * 1000);
+  printf(1, "peak heap %d KB\n", (peak - base) / 1024);
+  exit();
+}
@@ -0,0 +1,81 @@
+// Measure memmove and memset speed, in bytes per 100 TSC
+// cycles, for several sizes and alignments, against a
+// byte-at-a-time copy.
+// usage: membench
+
+#include "types.h"
+#include "user.h"
+#include "x86.h"
+
+#define BUFSZ  (64*1024 + 64)
+#define TOTAL  (8*1024*1024)   // bytes moved per measurement
+
+char *src, *dst;
+
+void
+bytecopy(void *vdst, const void *vsrc, int n)
+{
+  volatile char *d = vdst;
+  const char *s = vsrc;
+
+  while(n-- > 0)
+    *d++ = *s++;
+}
+
+// Bytes per 100 cycles moving TOTAL bytes n at a time.
+uint
+rate(int op, int n, int off)
+{
+  uint64 start;
+  uint cyc;
+  int i, iters;
+
+  iters = TOTAL / n;
+  start = rdtsc();
+  for(i = 0; i < iters; i++){
+    switch(op){
+    case 0:
+      bytecopy(dst + off, src, n);
+      break;
+    case 1:
+      memmove(dst + off, src, n);
+      break;
+    case 2:
+      memmove(dst + off, dst, n);   // overlapping, backward
+      break;
+    case 3:
+      memset(dst + off, i, n);
+      break;
+    }
+  }
+  cyc = (uint)(rdtsc() - start);
+  if(cyc == 0)
+    cyc = 1;
+  return (uint)TOTAL * 100 / cyc;
+}
+
+int
+main(int argc, char *argv[])
+{
+  static int sizes[] = { 16, 64, 512, 4096, 65536 };
+  int i, op;
+
+  src = malloc(BUFSZ);
+  dst = malloc(BUFSZ);
+  if(src == 0 || dst == 0){
+    printf(2, "membench: out of memory\n");
+    exit();
+  }
+  memset(src, 'x', BUFSZ);
+  memset(dst, 0, BUFSZ);
+
+  printf(1, "bytes per 100 cycles, aligned/misaligned\n");
+  printf(1, "size\tbytecopy\tmemmove\t\toverlap\t\tmemset\n");
+  for(i = 0; i < sizeof(sizes)/sizeof(sizes[0]); i++){
+    printf(1, "%d", sizes[i]);
+    for(op = 0; op < 4; op++)
+      printf(1, "\t%d/%d\t", rate(op, sizes[i], 4), rate(op, sizes[i], 1));
+    printf(1, "\n");
+  }
+  exit();
+}
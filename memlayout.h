@@ -8,6 +8,18 @@
 #define KERNBASE 0x80000000         // First kernel virtual address
 #define KERNLINK (KERNBASE+EXTMEM)  // Address where kernel is linked
 
+// The read-only time page (see tsc.c) sits just below the kernel,
+// then the read-only info page (see procinfo.h) and the system
+// call ring (see ring.h).
+#define TIMEPAGE (KERNBASE-0x1000)
+#define INFOPAGE (TIMEPAGE-0x1000)
+#define RINGPAGE (INFOPAGE-0x1000)
+
+// User memory ends at USERTOP; mmap() regions are placed below
+// MMAPTOP, growing down toward the heap.
+#define USERTOP  RINGPAGE
+#define MMAPTOP  USERTOP
+
 #define V2P(a) (((uint) (a)) - KERNBASE)
 #define P2V(a) ((void *)(((char *) (a)) + KERNBASE))
 
@@ -0,0 +1,322 @@
+// Memory-mapped files and anonymous memory.
+//
+// mmap() only records a region in the process's vma[] table.
+// Pages are filled in lazily by mmapfault() the first time the
+// process touches them, either from the backing file or zeroed.
+//
+// MAP_SHARED regions share physical pages with the children a
+// process forks, and dirty pages of a MAP_SHARED file mapping are
+// written back to the inode, through the log, when the region is
+// unmapped by munmap(), exit() or exec().  MAP_PRIVATE regions are
+// copied on fork and never written back.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "stat.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "proc.h"
+#include "x86.h"
+#include "fs.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "file.h"
+#include "fcntl.h"
+
+#define min(a, b) ((a) < (b) ? (a) : (b))
+
+// Return the region of p containing va, or 0.
+static struct vma*
+findvma(struct proc *p, uint va)
+{
+  struct vma *v;
+
+  for(v = p->vma; v < &p->vma[NVMA]; v++)
+    if(v->len && va >= v->addr && va < v->addr + v->len)
+      return v;
+  return 0;
+}
+
+// Lowest address used by any region of p.  The heap
+// may not grow past it.
+uint
+mmapbase(struct proc *p)
+{
+  struct vma *v;
+  uint base;
+
+  base = MMAPTOP;
+  for(v = p->vma; v < &p->vma[NVMA]; v++)
+    if(v->len && v->addr < base)
+      base = v->addr;
+  return base;
+}
+
+// Create a region of len bytes and return its address,
+// or -1.  f is the backing file, or 0 for MAP_ANONYMOUS.
+int
+mmap(uint len, int prot, int flags, struct file *f, uint off)
+{
+  struct proc *p = myproc();
+  struct vma *v, *nv;
+  uint base;
+  int type;
+
+  if(len == 0 || len >= MMAPTOP || off % PGSIZE != 0)
+    return -1;
+  if(((flags & MAP_SHARED) != 0) == ((flags & MAP_PRIVATE) != 0))
+    return -1;
+  if((f == 0) != ((flags & MAP_ANONYMOUS) != 0))
+    return -1;
+  if(f){
+    if(f->type != FD_INODE)
+      return -1;
+    if((prot & PROT_READ) && !f->readable)
+      return -1;
+    if((prot & PROT_WRITE) && (flags & MAP_SHARED) && !f->writable)
+      return -1;
+    ilock(f->ip);
+    type = f->ip->type;
+    iunlock(f->ip);
+    if(type != T_FILE)
+      return -1;
+  }
+
+  nv = 0;
+  for(v = p->vma; v < &p->vma[NVMA]; v++){
+    if(v->len == 0){
+      nv = v;
+      break;
+    }
+  }
+  if(nv == 0)
+    return -1;
+
+  len = PGROUNDUP(len);
+  base = mmapbase(p);
+  if(base < len || base - len < PGROUNDUP(p->sz))
+    return -1;
+
+  nv->addr = base - len;
+  nv->len = len;
+  nv->prot = prot;
+  nv->flags = flags;
+  nv->off = off;
+  nv->f = f ? filedup(f) : 0;
+  return nv->addr;
+}
+
+// Fill in the page containing va after a fault on a
+// mapped region.  Returns -1 if va is not mapped or the
+// access is not allowed by the region's protection.
+int
+mmapfault(struct proc *p, uint va, int write)
+{
+  struct vma *v;
+  pte_t *pte;
+  char *mem;
+  int perm;
+
+  if((v = findvma(p, va)) == 0)
+    return -1;
+  if((v->prot & (PROT_READ|PROT_WRITE)) == 0)
+    return -1;
+  if(write && (v->prot & PROT_WRITE) == 0)
+    return -1;
+
+  va = PGROUNDDOWN(va);
+  if((pte = walkpgdir(p->pgdir, (char*)va, 0)) != 0 && (*pte & PTE_P))
+    return (write && (*pte & PTE_W) == 0) ? -1 : 0;
+
+  if((mem = kalloc()) == 0)
+    return -1;
+  memset(mem, 0, PGSIZE);
+  if(v->f){
+    // A read past the end of the file leaves the page zeroed.
+    ilock(v->f->ip);
+    readi(v->f->ip, mem, v->off + (va - v->addr), PGSIZE);
+    iunlock(v->f->ip);
+  }
+
+  perm = PTE_U;
+  if(v->prot & PROT_WRITE)
+    perm |= PTE_W;
+  if(mappages(p->pgdir, (char*)va, PGSIZE, V2P(mem), perm) < 0){
+    kfree(mem);
+    return -1;
+  }
+  return 0;
+}
+
+// Make sure [va, va+n) lies in mapped regions of p and that
+// its pages are present, so that the kernel can use it as a
+// system call buffer without faulting.  write says whether
+// the kernel will store to the buffer.
+int
+mmapprefault(struct proc *p, uint va, int n, int write)
+{
+  uint a, last;
+  pte_t *pte;
+
+  if(n < 0 || va + n < va || findvma(p, va) == 0)
+    return -1;
+  if(n == 0)
+    return 0;
+  last = PGROUNDDOWN(va + n - 1);
+  for(a = PGROUNDDOWN(va); a <= last; a += PGSIZE){
+    pte = walkpgdir(p->pgdir, (char*)a, 0);
+    if(pte == 0 || (*pte & PTE_P) == 0 || (write && (*pte & PTE_W) == 0))
+      if(mmapfault(p, a, write) < 0)
+        return -1;
+  }
+  return 0;
+}
+
+// Write one dirty page of a MAP_SHARED file mapping back to
+// the inode, in a single log transaction.  The file is
+// never extended.
+static void
+writeback(struct vma *v, uint va, char *mem)
+{
+  struct inode *ip = v->f->ip;
+  uint off, n;
+
+  off = v->off + (va - v->addr);
+  ilock(ip);
+  n = ip->size > off ? min(ip->size - off, PGSIZE) : 0;
+  iunlock(ip);
+  if(n == 0)
+    return;
+
+  begin_opn(WRITEBLOCKS(PGSIZE));
+  ilock(ip);
+  writei(ip, mem, off, n);
+  iunlock(ip);
+  end_opn(WRITEBLOCKS(PGSIZE));
+}
+
+// Remove the pages of [addr, addr+len) in region v from p's
+// page table, writing back dirty pages of shared files.
+static void
+unmappages(struct proc *p, struct vma *v, uint addr, uint len)
+{
+  uint a;
+  pte_t *pte;
+  char *mem;
+
+  for(a = addr; a < addr + len; a += PGSIZE){
+    if((pte = walkpgdir(p->pgdir, (char*)a, 0)) == 0 || (*pte & PTE_P) == 0)
+      continue;
+    mem = P2V(PTE_ADDR(*pte));
+    if(v->f && (v->flags & MAP_SHARED) && (*pte & PTE_D))
+      writeback(v, a, mem);
+    kfree(mem);
+    *pte = 0;
+  }
+  if(p == myproc())
+    lcr3(V2P(p->pgdir));  // flush stale TLB entries
+}
+
+// Unmap [addr, addr+len), which must be the beginning, the
+// end or the whole of one region.
+int
+munmap(uint addr, uint len)
+{
+  struct proc *p = myproc();
+  struct vma *v;
+
+  if(addr % PGSIZE != 0 || len == 0 || (v = findvma(p, addr)) == 0)
+    return -1;
+  len = PGROUNDUP(len);
+  if(addr + len < addr || addr + len > v->addr + v->len)
+    return -1;
+  if(addr != v->addr && addr + len != v->addr + v->len)
+    return -1;  // would punch a hole in the region
+
+  unmappages(p, v, addr, len);
+  if(addr == v->addr){
+    v->addr += len;
+    v->off += len;
+  }
+  v->len -= len;
+  if(v->len == 0){
+    if(v->f)
+      fileclose(v->f);
+    v->f = 0;
+  }
+  return 0;
+}
+
+// Unmap every region of p.  Called by exit() and exec()
+// while p->pgdir is still the page table being discarded.
+void
+mmapexit(struct proc *p)
+{
+  struct vma *v;
+
+  for(v = p->vma; v < &p->vma[NVMA]; v++){
+    if(v->len == 0)
+      continue;
+    unmappages(p, v, v->addr, v->len);
+    if(v->f)
+      fileclose(v->f);
+    v->f = 0;
+    v->len = 0;
+  }
+}
+
+// Give child np a copy of p's regions.  Pages of shared
+// regions are faulted in and then mapped by both processes,
+// since a page each process faulted in later on its own would
+// not be shared; pages of private regions are copied.
+int
+mmapfork(struct proc *p, struct proc *np)
+{
+  struct vma *v, *nv;
+  uint a, flags;
+  pte_t *pte;
+  char *mem;
+
+  memset(np->vma, 0, sizeof(np->vma));
+  for(v = p->vma, nv = np->vma; v < &p->vma[NVMA]; v++, nv++){
+    if(v->len == 0)
+      continue;
+    *nv = *v;
+    if(nv->f)
+      filedup(nv->f);
+    for(a = v->addr; a < v->addr + v->len; a += PGSIZE){
+      // A region with no access can never be touched, so
+      // has nothing to share.
+      if((v->flags & MAP_SHARED) && (v->prot & (PROT_READ|PROT_WRITE)) &&
+         mmapfault(p, a, 0) < 0)
+        goto bad;
+      if((pte = walkpgdir(p->pgdir, (char*)a, 0)) == 0 || (*pte & PTE_P) == 0)
+        continue;
+      flags = PTE_FLAGS(*pte) & ~PTE_D;
+      if(v->flags & MAP_SHARED){
+        mem = P2V(PTE_ADDR(*pte));
+        kdup(mem);
+      } else {
+        if((mem = kalloc()) == 0)
+          goto bad;
+        memmove(mem, P2V(PTE_ADDR(*pte)), PGSIZE);
+      }
+      if(mappages(np->pgdir, (char*)a, PGSIZE, V2P(mem), flags) < 0){
+        kfree(mem);
+        goto bad;
+      }
+    }
+  }
+  return 0;
+
+bad:
+  // The pages already mapped are freed with np->pgdir.
+  for(nv = np->vma; nv < &np->vma[NVMA]; nv++){
+    if(nv->len && nv->f)
+      fileclose(nv->f);
+    nv->f = 0;
+    nv->len = 0;
+  }
+  return -1;
+}
@@ -7,18 +7,69 @@
 #include "spinlock.h"
 #include "sleeplock.h"
 #include "file.h"
+#include "slab.h"
 
-#define PIPESIZE 512
+#define PIPESIZE      PGSIZE  // default ring size in bytes
+#define PIPEMAXPAGES  16      // largest ring, in pages
 
+#define min(a, b) ((a) < (b) ? (a) : (b))
+
+// The ring is made of separately allocated pages, so data is
+// copied in runs that end at a page boundary.  size is always
+// a power of two so that nread and nwrite can wrap around.
 struct pipe {
   struct spinlock lock;
-  char data[PIPESIZE];
+  char *data[PIPEMAXPAGES];  // ring pages
+  uint size;      // ring size in bytes
   uint nread;     // number of bytes read
   uint nwrite;    // number of bytes written
   int readopen;   // read fd is still open
   int writeopen;  // write fd is still open
+  int rwaiting;   // readers sleeping on nread
+  int wwaiting;   // writers sleeping on nwrite
+  int rbusy;      // a splice is draining the ring
+  int wbusy;      // a splice is filling the ring
 };
 
+// Address of byte off of the ring, and the number of bytes
+// from there to the end of its page.
+static char*
+ringptr(struct pipe *p, uint off, uint *run)
+{
+  off %= p->size;
+  *run = PGSIZE - off%PGSIZE;
+  return p->data[off/PGSIZE] + off%PGSIZE;
+}
+
+// Copy n bytes between buf and the ring starting at ring
+// offset off, towards the ring if toring is set.
+static void
+ringcopy(struct pipe *p, uint off, char *buf, uint n, int toring)
+{
+  uint m, run;
+  char *r;
+
+  while(n > 0){
+    r = ringptr(p, off, &run);
+    m = min(n, run);
+    if(toring)
+      memmove(r, buf, m);
+    else
+      memmove(buf, r, m);
+    off += m;
+    buf += m;
+    n -= m;
+  }
+}
+
+static struct slabcache pipecache;
+
+void
+pipeinit(void)
+{
+  slabinit(&pipecache, "pipe", sizeof(struct pipe), 0);
+}
+
 int
 pipealloc(struct file **f0, struct file **f1)
 {
@@ -28,12 +79,20 @@ pipealloc(struct file **f0, struct file **f1)
   *f0 = *f1 = 0;
   if((*f0 = filealloc()) == 0 || (*f1 = filealloc()) == 0)
     goto bad;
-  if((p = (struct pipe*)kalloc()) == 0)
+  if((p = slaballoc(&pipecache)) == 0)
     goto bad;
+  memset(p->data, 0, sizeof(p->data));
+  if((p->data[0] = kalloc()) == 0)
+    goto bad;
+  p->size = PIPESIZE;
   p->readopen = 1;
   p->writeopen = 1;
   p->nwrite = 0;
   p->nread = 0;
+  p->rwaiting = 0;
+  p->wwaiting = 0;
+  p->rbusy = 0;
+  p->wbusy = 0;
   initlock(&p->lock, "pipe");
   (*f0)->type = FD_PIPE;
   (*f0)->readable = 1;
@@ -48,7 +107,7 @@ pipealloc(struct file **f0, struct file **f1)
 //PAGEBREAK: 20
  bad:
   if(p)
-    kfree((char*)p);
+    slabfree(&pipecache, p);
   if(*f0)
     fileclose(*f0);
   if(*f1)
@@ -56,6 +115,16 @@ pipealloc(struct file **f0, struct file **f1)
   return -1;
 }
 
+static void
+pipefree(struct pipe *p)
+{
+  int i;
+
+  for(i = 0; i < p->size/PGSIZE; i++)
+    kfree(p->data[i]);
+  slabfree(&pipecache, p);
+}
+
 void
 pipeclose(struct pipe *p, int writable)
 {
@@ -69,30 +138,103 @@ pipeclose(struct pipe *p, int writable)
   }
   if(p->readopen == 0 && p->writeopen == 0){
     release(&p->lock);
-    kfree((char*)p);
+    pipefree(p);
   } else
     release(&p->lock);
 }
 
+// Resize the ring of p to hold at least n bytes, rounded
+// up to a power-of-two number of pages.  n == 0 just
+// reports the current size.  Fails if the unread data
+// would not fit.  Returns the new size, or -1.
+int
+pipesize(struct pipe *p, int n)
+{
+  char *data[PIPEMAXPAGES], *r;
+  uint npages, size, len, i, m, run;
+  int ret;
+
+  if(n == 0)
+    return p->size;
+  if(n < 0 || n > PIPEMAXPAGES*PGSIZE)
+    return -1;
+  for(npages = 1; npages*PGSIZE < n; npages *= 2)
+    ;
+  size = npages*PGSIZE;
+
+  ret = -1;
+  memset(data, 0, sizeof(data));
+  for(i = 0; i < npages; i++){
+    if((data[i] = kalloc()) == 0)
+      goto out;
+  }
+
+  acquire(&p->lock);
+  while(p->rbusy || p->wbusy){
+    p->wwaiting++;
+    sleep(&p->nwrite, &p->lock);
+    p->wwaiting--;
+  }
+  len = p->nwrite - p->nread;
+  if(len > size){
+    release(&p->lock);
+    goto out;
+  }
+  // Move the unread bytes to the start of the new ring.
+  for(i = 0; i < len; i += m){
+    r = ringptr(p, p->nread + i, &run);
+    m = min(min(len - i, run), PGSIZE - i%PGSIZE);
+    memmove(data[i/PGSIZE] + i%PGSIZE, r, m);
+  }
+  for(i = 0; i < PIPEMAXPAGES; i++){
+    r = p->data[i];
+    p->data[i] = data[i];
+    data[i] = i < p->size/PGSIZE ? r : 0;
+  }
+  p->size = size;
+  p->nread = 0;
+  p->nwrite = len;
+  if(p->wwaiting)
+    wakeup(&p->nwrite);
+  release(&p->lock);
+  ret = size;
+
+out:
+  for(i = 0; i < PIPEMAXPAGES; i++)
+    if(data[i])
+      kfree(data[i]);
+  return ret;
+}
+
 //PAGEBREAK: 40
 int
 pipewrite(struct pipe *p, char *addr, int n)
 {
-  int i;
+  int i, m;
 
   acquire(&p->lock);
-  for(i = 0; i < n; i++){
-    while(p->nwrite == p->nread + PIPESIZE){  //DOC: pipewrite-full
+  for(i = 0; i < n; i += m){
+    while(p->wbusy || p->nwrite == p->nread + p->size){  //DOC: pipewrite-full
       if(p->readopen == 0 || myproc()->killed){
         release(&p->lock);
         return -1;
       }
-      wakeup(&p->nread);
+      if(p->rwaiting)
+        wakeup(&p->nread);
+      p->wwaiting++;
       sleep(&p->nwrite, &p->lock);  //DOC: pipewrite-sleep
+      p->wwaiting--;
     }
-    p->data[p->nwrite++ % PIPESIZE] = addr[i];
+    m = min(n - i, p->size - (p->nwrite - p->nread));
+    ringcopy(p, p->nwrite, addr + i, m, 1);
+    p->nwrite += m;
+    // Let a sleeping reader start draining a long write
+    // once the ring is half full.
+    if(p->rwaiting && p->nwrite - p->nread >= p->size/2)
+      wakeup(&p->nread);
   }
-  wakeup(&p->nread);  //DOC: pipewrite-wakeup1
+  if(p->rwaiting)
+    wakeup(&p->nread);  //DOC: pipewrite-wakeup1
   release(&p->lock);
   return n;
 }
@@ -100,22 +242,118 @@ pipewrite(struct pipe *p, char *addr, int n)
 int
 piperead(struct pipe *p, char *addr, int n)
 {
-  int i;
+  int m;
 
   acquire(&p->lock);
-  while(p->nread == p->nwrite && p->writeopen){  //DOC: pipe-empty
+  while(p->rbusy || (p->nread == p->nwrite && p->writeopen)){  //DOC: pipe-empty
     if(myproc()->killed){
       release(&p->lock);
       return -1;
     }
+    p->rwaiting++;
     sleep(&p->nread, &p->lock); //DOC: piperead-sleep
+    p->rwaiting--;
+  }
+  m = min(n, p->nwrite - p->nread);  //DOC: piperead-copy
+  ringcopy(p, p->nread, addr, m, 0);
+  p->nread += m;
+  // A writer blocked on a full ring is only woken once
+  // half of it is free again.
+  if(p->wwaiting && p->size - (p->nwrite - p->nread) >= p->size/2)
+    wakeup(&p->nwrite);  //DOC: piperead-wakeup
+  release(&p->lock);
+  return m;
+}
+
+// Splice support.  pipebeginread() and pipebeginwrite() hand
+// the caller one run of the ring, which it then drains or
+// fills directly with writei(), readi() or another pipe,
+// without holding p->lock.  rbusy and wbusy keep other
+// readers, writers and pipesize() away until the matching
+// pipeend call records how much of the run was used.
+
+// Wait for data and return in *addr the next run of at
+// most n unread bytes.  Returns its length, 0 at end of
+// file or if the ring is empty and wait is 0, or -1.
+int
+pipebeginread(struct pipe *p, char **addr, int n, int wait)
+{
+  uint run;
+
+  acquire(&p->lock);
+  while(p->rbusy || (p->nread == p->nwrite && p->writeopen)){
+    if(myproc()->killed){
+      release(&p->lock);
+      return -1;
+    }
+    if(!wait){
+      release(&p->lock);
+      return 0;
+    }
+    p->rwaiting++;
+    sleep(&p->nread, &p->lock);
+    p->rwaiting--;
   }
-  for(i = 0; i < n; i++){  //DOC: piperead-copy
-    if(p->nread == p->nwrite)
-      break;
-    addr[i] = p->data[p->nread++ % PIPESIZE];
+  *addr = ringptr(p, p->nread, &run);
+  n = min(n, min(run, p->nwrite - p->nread));
+  if(n > 0)
+    p->rbusy = 1;
+  release(&p->lock);
+  return n;
+}
+
+// Finish a pipebeginread() that consumed n bytes.
+void
+pipeendread(struct pipe *p, int n)
+{
+  acquire(&p->lock);
+  p->nread += n;
+  p->rbusy = 0;
+  if(p->rwaiting)
+    wakeup(&p->nread);
+  if(p->wwaiting)
+    wakeup(&p->nwrite);
+  release(&p->lock);
+}
+
+// Wait for free space and return in *addr the next free
+// run of at most n bytes.  Returns its length, or -1 if
+// the read side is closed.
+int
+pipebeginwrite(struct pipe *p, char **addr, int n)
+{
+  uint run;
+
+  acquire(&p->lock);
+  while(p->wbusy || p->nwrite == p->nread + p->size){
+    if(p->readopen == 0 || myproc()->killed){
+      release(&p->lock);
+      return -1;
+    }
+    if(p->rwaiting)
+      wakeup(&p->nread);
+    p->wwaiting++;
+    sleep(&p->nwrite, &p->lock);
+    p->wwaiting--;
   }
-  wakeup(&p->nwrite);  //DOC: piperead-wakeup
+  *addr = ringptr(p, p->nwrite, &run);
+  n = min(n, min(run, p->size - (p->nwrite - p->nread)));
+  if(n > 0)
+    p->wbusy = 1;
+  release(&p->lock);
+  return n;
+}
+
+// Finish a pipebeginwrite() that filled n bytes.
+void
+pipeendwrite(struct pipe *p, int n)
+{
+  acquire(&p->lock);
+  p->nwrite += n;
+  p->wbusy = 0;
+  if(p->rwaiting)
+    wakeup(&p->nread);
+  if(p->wwaiting)
+    wakeup(&p->nwrite);
   release(&p->lock);
-  return i;
 }
@@ -0,0 +1,72 @@
+// Measure pipe throughput.
+// usage: pipebench [megabytes [ringsize [chunk]]]
+
+#include "types.h"
+#include "user.h"
+
+#define BUFSZ (64*1024)
+
+char buf[BUFSZ];
+
+int
+main(int argc, char *argv[])
+{
+  int fds[2], mb, ring, chunk, n, pid;
+  uint total, left, start, ticks;
+
+  mb = argc > 1 ? atoi(argv[1]) : 16;
+  ring = argc > 2 ? atoi(argv[2]) : 0;
+  chunk = argc > 3 ? atoi(argv[3]) : 4096;
+  if(mb <= 0 || chunk <= 0 || chunk > BUFSZ){
+    printf(2, "usage: pipebench [megabytes [ringsize [chunk]]]\n");
+    exit();
+  }
+  total = mb * 1024 * 1024;
+
+  if(pipe(fds) < 0){
+    printf(2, "pipebench: pipe failed\n");
+    exit();
+  }
+  if(ring > 0 && pipesize(fds[1], ring) < 0){
+    printf(2, "pipebench: cannot set ring size %d\n", ring);
+    exit();
+  }
+  ring = pipesize(fds[1], 0);
+
+  start = uptime();
+  pid = fork();
+  if(pid < 0){
+    printf(2, "pipebench: fork failed\n");
+    exit();
+  }
+  if(pid == 0){
+    close(fds[0]);
+    for(left = total; left > 0; left -= n){
+      n = left < chunk ? left : chunk;
+      if(write(fds[1], buf, n) != n){
+        printf(2, "pipebench: write failed\n");
+        break;
+      }
+    }
+    close(fds[1]);
+    exit();
+  }
+
+  close(fds[1]);
+  for(left = total; left > 0; left -= n){
+    if((n = read(fds[0], buf, BUFSZ)) <= 0){
+      printf(2, "pipebench: short read\n");
+      break;
+    }
+  }
+  close(fds[0]);
+  wait();
+  ticks = uptime() - start;
+  if(ticks == 0)
+    ticks = 1;
+
+  // uptime() counts 100 ticks a second.
+  printf(1, "%d MB through a %d byte ring in %d ticks: %d KB/s\n",
+         mb, ring, ticks, (total / 1024) * 100 / ticks);
+  exit();
+}
@@ -1,11 +1,88 @@
 #include "types.h"
 #include "stat.h"
 #include "user.h"
+#include "param.h"
+
+// printf() output is buffered per file descriptor.  A buffer
+// is flushed when it fills, and also at each newline for a
+// device such as the console, at the end of each printf()
+// for fd 2, and before fork(), exec(), close() and exit().
+
+#define BUFSZ 512
+
+#define FULLBUF 1
+#define LINEBUF 2
+#define NOBUF   3
+
+static struct outbuf {
+  int mode;  // 0 until the first output to the fd
+  int n;
+  char buf[BUFSZ];
+} out[NOFILE];
+
+static int
+bufmode(int fd)
+{
+  struct stat st;
+
+  if(fd == 2)
+    return NOBUF;
+  if(fstat(fd, &st) >= 0 && st.type == T_DEV)
+    return LINEBUF;
+  return FULLBUF;
+}
+
+// Write out fd's buffered output.
+int
+fflush(int fd)
+{
+  struct outbuf *b;
+  int n;
+
+  if(fd < 0 || fd >= NOFILE)
+    return -1;
+  b = &out[fd];
+  n = b->n;
+  b->n = 0;
+  if(n > 0 && write(fd, b->buf, n) != n)
+    return -1;
+  return 0;
+}
+
+void
+fflushall(void)
+{
+  int fd;
+
+  for(fd = 0; fd < NOFILE; fd++)
+    fflush(fd);
+}
+
+// Called by close(): the fd may next refer to another file.
+void
+fdrelease(int fd)
+{
+  if(fd < 0 || fd >= NOFILE)
+    return;
+  fflush(fd);
+  out[fd].mode = 0;
+}
 
 static void
 putc(int fd, char c)
 {
-  write(fd, &c, 1);
+  struct outbuf *b;
+
+  if(fd < 0 || fd >= NOFILE){
+    write(fd, &c, 1);
+    return;
+  }
+  b = &out[fd];
+  if(b->mode == 0)
+    b->mode = bufmode(fd);
+  b->buf[b->n++] = c;
+  if(b->n == BUFSZ || (c == '\n' && b->mode == LINEBUF))
+    fflush(fd);
 }
 
 static void
@@ -82,4 +159,6 @@ printf(int fd, const char *fmt, ...)
       state = 0;
     }
   }
+  if(fd >= 0 && fd < NOFILE && out[fd].mode == NOBUF)
+    fflush(fd);
 }
@@ -6,10 +6,44 @@
 #include "x86.h"
 #include "proc.h"
 #include "spinlock.h"
+#include "traps.h"
+#include "date.h"
+#include "rusage.h"
+#include "trace.h"
+#include "slab.h"
+#include "procinfo.h"
+
+// Sleeping processes are hashed by wait channel, so that
+// wakeup() only looks at processes sleeping on a channel
+// that hashes like its own.
+#define NCHANHASH 64
+#define CHANHASH(chan) ((((uint)(chan) >> 4) ^ ((uint)(chan) >> 12)) % NCHANHASH)
+
+// Processes in sleepticks() wait on a timer wheel instead:
+// slot t % NWHEEL holds those whose deadline is t, t+NWHEEL,
+// and so on, and is checked when ticks reaches t.
+#define NWHEEL 64
+
+// Processes are allocated from a slab cache as needed.  Each
+// is on the list of all processes and hashed by pid; RUNNABLE
+// ones are also queued on the run queue of their scheduling
+// queue, so that the scheduler only looks at runnable ones.
+#define NPIDHASH 256
+#define PIDHASH(pid) ((uint)(pid) % NPIDHASH)
+
+struct runq {
+  struct proc *head;
+  struct proc **tail;                // &last->nextrun, or &head
+};
 
 struct {
   struct spinlock lock;
-  struct proc proc[NPROC];
+  struct slabcache cache;
+  struct proc *all;                  // every process
+  struct proc *pidhash[NPIDHASH];    // processes by pid
+  struct runq runq[FCFS+1];          // RUNNABLE processes by queue
+  struct proc *chanhash[NCHANHASH];  // sleeping processes by chan
+  struct proc *wheel[NWHEEL];        // sleeping processes by deadline
 } ptable;
 
 static struct proc *initproc;
@@ -19,11 +53,140 @@ extern void forkret(void);
 extern void trapret(void);
 
 static void wakeup1(void *chan);
+static void preempt(struct proc *p);
+static void chanremove(struct proc *p);
 
 void
 pinit(void)
 {
+  int q;
+
   initlock(&ptable.lock, "ptable");
+  slabinit(&ptable.cache, "proc", sizeof(struct proc), 0);
+  for(q = 0; q <= FCFS; q++)
+    ptable.runq[q].tail = &ptable.runq[q].head;
+}
+
+// Return the process with the given pid, or 0.
+// The ptable lock must be held.
+static struct proc*
+findproc(int pid)
+{
+  struct proc *p;
+
+  for(p = ptable.pidhash[PIDHASH(pid)]; p != 0; p = p->nexthash)
+    if(p->pid == pid)
+      return p;
+  return 0;
+}
+
+// Make p a child of parent.  The ptable lock must be held.
+static void
+addchild(struct proc *parent, struct proc *p)
+{
+  p->parent = parent;
+  p->sibling = parent->children;
+  p->pprevsibling = &parent->children;
+  if(parent->children)
+    parent->children->pprevsibling = &p->sibling;
+  parent->children = p;
+}
+
+static void
+delchild(struct proc *p)
+{
+  if(p->pprevsibling == 0)
+    return;
+  *p->pprevsibling = p->sibling;
+  if(p->sibling)
+    p->sibling->pprevsibling = p->pprevsibling;
+  p->sibling = 0;
+  p->pprevsibling = 0;
+}
+
+static int
+validqueue(int q)
+{
+  return q >= ROUND_ROBIN && q <= FCFS;
+}
+
+// Append RUNNABLE p to its queue's run queue.
+// The ptable lock must be held.
+static void
+runqadd(struct proc *p)
+{
+  struct runq *q;
+
+  if(!validqueue(p->sched_queue))
+    p->sched_queue = PRIORITY;
+  q = &ptable.runq[p->sched_queue];
+  p->nextrun = 0;
+  p->pprevrun = q->tail;
+  *q->tail = p;
+  q->tail = &p->nextrun;
+}
+
+static void
+runqdel(struct proc *p)
+{
+  if(p->pprevrun == 0)
+    return;
+  *p->pprevrun = p->nextrun;
+  if(p->nextrun)
+    p->nextrun->pprevrun = p->pprevrun;
+  else
+    ptable.runq[p->sched_queue].tail = p->pprevrun;
+  p->nextrun = 0;
+  p->pprevrun = 0;
+}
+
+// Make p RUNNABLE.  The ptable lock must be held.
+static void
+setrunnable(struct proc *p)
+{
+  p->state = RUNNABLE;
+  runqadd(p);
+}
+
+// Copy p's fields shown to user code to its info page.
+static void
+setinfo(struct proc *p)
+{
+  p->info->pid = p->pid;
+  p->info->ctime = p->ctime;
+  p->info->sched_queue = p->sched_queue;
+  p->info->priority = p->priority;
+}
+
+// Move p to scheduling queue q.  The ptable lock must be held.
+static void
+setqueue(struct proc *p, int q)
+{
+  if(p->pprevrun){
+    runqdel(p);
+    p->sched_queue = q;
+    runqadd(p);
+  } else
+    p->sched_queue = q;
+  setinfo(p);
+}
+
+// Take p off every list and free it.  The ptable lock
+// must be held.
+static void
+freeproc(struct proc *p)
+{
+  *p->pprevall = p->nextall;
+  if(p->nextall)
+    p->nextall->pprevall = p->pprevall;
+  *p->pprevhash = p->nexthash;
+  if(p->nexthash)
+    p->nexthash->pprevhash = p->pprevhash;
+  delchild(p);
+  if(p->info)
+    kfree((char*)p->info);
+  p->state = UNUSED;
+  slabfree(&ptable.cache, p);
 }
 
 // Must be called with interrupts disabled
@@ -66,39 +229,47 @@ myproc(void) {
 }
 
 //PAGEBREAK: 32
-// Look in the process table for an UNUSED proc.
-// If found, change state to EMBRYO and initialize
+// Allocate a proc, in state EMBRYO, and initialize
 // state required to run in the kernel.
-// Otherwise return 0.
+// Return 0 if there is no memory.
 static struct proc*
 allocproc(void)
 {
   struct proc *p;
   char *sp;
 
-  acquire(&ptable.lock);
-
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
-    if(p->state == UNUSED)
-      goto found;
+  if((p = slaballoc(&ptable.cache)) == 0)
+    return 0;
+  memset(p, 0, sizeof(*p));
 
-  release(&ptable.lock);
-  return 0;
+  acquire(&ptable.lock);
 
-found:
   p->state = EMBRYO;
   p->pid = nextpid++;
-  
   p->ctime = ticks;
-
+  p->nextall = ptable.all;
+  p->pprevall = &ptable.all;
+  if(ptable.all)
+    ptable.all->pprevall = &p->nextall;
+  ptable.all = p;
+  p->nexthash = ptable.pidhash[PIDHASH(p->pid)];
+  p->pprevhash = &ptable.pidhash[PIDHASH(p->pid)];
+  if(p->nexthash)
+    p->nexthash->pprevhash = &p->nexthash;
+  *p->pprevhash = p;
 
   release(&ptable.lock);
 
-  // Allocate kernel stack.
-  if((p->kstack = kalloc()) == 0){
-    p->state = UNUSED;
+  // Allocate kernel stack and info page.
+  if((p->kstack = kalloc()) == 0 || (p->info = (struct infopage*)kalloc()) == 0){
+    if(p->kstack)
+      kfree(p->kstack);
+    acquire(&ptable.lock);
+    freeproc(p);
+    release(&ptable.lock);
     return 0;
   }
+  memset(p->info, 0, PGSIZE);
   sp = p->kstack + KSTACKSIZE;
 
   // Leave room for trap frame.
@@ -121,6 +292,11 @@ found:
   p->priority_ratio = 1;
   p->executed_cycle_ratio = 1;
   p->arrival_time = ticks;
+  p->quantum = 0;
+  p->slice = 0;
+  memset(&p->acct, 0, sizeof(p->acct));
+  memset(&p->cacct, 0, sizeof(p->cacct));
+  setinfo(p);
 
   return p;
 }
@@ -136,7 +312,7 @@ userinit(void)
   p = allocproc();
   
   initproc = p;
-  if((p->pgdir = setupkvm()) == 0)
+  if((p->pgdir = setupkvm()) == 0 || mapinfo(p->pgdir, (char*)p->info) < 0)
     panic("userinit: out of memory?");
   inituvm(p->pgdir, _binary_initcode_start, (int)_binary_initcode_size);
   p->sz = PGSIZE;
@@ -158,7 +334,8 @@ userinit(void)
   // because the assignment might not be atomic.
   acquire(&ptable.lock);
 
-  p->state = RUNNABLE;
+  p->stamp = rdtsc();
+  setrunnable(p);
 
   release(&ptable.lock);
 }
@@ -173,6 +350,9 @@ growproc(int n)
 
   sz = curproc->sz;
   if(n > 0){
+    // Don't grow into memory-mapped regions.
+    if(sz + n < sz || sz + n > mmapbase(curproc))
+      return -1;
     if((sz = allocuvm(curproc->pgdir, sz, sz + n)) == 0)
       return -1;
   } else if(n < 0){
@@ -202,12 +382,20 @@ fork(void)
   // Copy process state from proc.
   if((np->pgdir = copyuvm(curproc->pgdir, curproc->sz)) == 0){
     kfree(np->kstack);
-    np->kstack = 0;
-    np->state = UNUSED;
+    acquire(&ptable.lock);
+    freeproc(np);
+    release(&ptable.lock);
     return -1;
   }
   np->sz = curproc->sz;
-  np->parent = curproc;
+  if(mapinfo(np->pgdir, (char*)np->info) < 0 || mmapfork(curproc, np) < 0){
+    freevm(np->pgdir);
+    kfree(np->kstack);
+    acquire(&ptable.lock);
+    freeproc(np);
+    release(&ptable.lock);
+    return -1;
+  }
   *np->tf = *curproc->tf;
 
   // Clear %eax so that fork returns 0 in the child.
@@ -224,7 +412,9 @@ fork(void)
 
   acquire(&ptable.lock);
 
-  np->state = RUNNABLE;
+  addchild(curproc, np);
+  np->stamp = rdtsc();
+  setrunnable(np);
 
   release(&ptable.lock);
 
@@ -239,11 +429,14 @@ exit(void)
 {
   struct proc *curproc = myproc();
   struct proc *p;
-  int fd;
+  int fd, zombie;
 
   if(curproc == initproc)
     panic("init exiting");
 
+  // Write back and unmap memory-mapped regions.
+  mmapexit(curproc);
+
   // Close all open files.
   for(fd = 0; fd < NOFILE; fd++){
     if(curproc->ofile[fd]){
@@ -262,13 +455,26 @@ exit(void)
   // Parent might be sleeping in wait().
   wakeup1(curproc->parent);
 
-  // Pass abandoned children to init.
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-    if(p->parent == curproc){
+  // Pass abandoned children to init, splicing the whole
+  // list onto the front of init's.
+  if((p = curproc->children) != 0){
+    zombie = 0;
+    for(;;){
       p->parent = initproc;
       if(p->state == ZOMBIE)
-        wakeup1(initproc);
+        zombie = 1;
+      if(p->sibling == 0)
+        break;
+      p = p->sibling;
     }
+    p->sibling = initproc->children;
+    if(p->sibling)
+      p->sibling->pprevsibling = &p->sibling;
+    initproc->children = curproc->children;
+    initproc->children->pprevsibling = &initproc->children;
+    curproc->children = 0;
+    if(zombie)
+      wakeup1(initproc);
   }
 
   // Jump into the scheduler, never to return.
@@ -277,42 +483,45 @@ exit(void)
   panic("zombie exit");
 }
 
+// Add the CPU usage in b to a.
+static void
+addacct(struct acct *a, struct acct *b)
+{
+  a->utime += b->utime;
+  a->stime += b->stime;
+  a->wtime += b->wtime;
+  a->nvcsw += b->nvcsw;
+  a->nivcsw += b->nivcsw;
+}
+
 // Wait for a child process to exit and return its pid.
 // Return -1 if this process has no children.
 int
 wait(void)
 {
   struct proc *p;
-  int havekids, pid;
+  int pid;
   struct proc *curproc = myproc();
   
   acquire(&ptable.lock);
   for(;;){
-    // Scan through table looking for exited children.
-    havekids = 0;
-    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-      if(p->parent != curproc)
-        continue;
-      havekids = 1;
+    // Scan through the children looking for exited ones.
+    for(p = curproc->children; p != 0; p = p->sibling){
       if(p->state == ZOMBIE){
         // Found one.
         pid = p->pid;
+        addacct(&curproc->cacct, &p->acct);
+        addacct(&curproc->cacct, &p->cacct);
         kfree(p->kstack);
-        p->kstack = 0;
         freevm(p->pgdir);
-        p->pid = 0;
-        p->parent = 0;
-        p->name[0] = 0;
-        p->killed = 0;
-        p->state = UNUSED;
-        p->ctime = 0;
+        freeproc(p);
         release(&ptable.lock);
         return pid;
       }
     }
 
     // No point waiting if we don't have any children.
-    if(!havekids || curproc->killed){
+    if(curproc->children == 0 || curproc->killed){
       release(&ptable.lock);
       return -1;
     }
@@ -338,6 +547,37 @@ generate_random_priority(int mod)
   return random_ticket;
 }
 
+// Time slice, in timer ticks, of each scheduling queue.
+// Lower queues hold batch work, which gains little from
+// being preempted often.
+static int queue_slice[FCFS + 1] = {
+[ROUND_ROBIN] 1,
+[PRIORITY]    2,
+[BJF]         4,
+[FCFS]        8,
+};
+
+// Time slice of p: its own, if set, or its queue's.
+static int
+proc_slice(struct proc *p)
+{
+  if(p->quantum > 0)
+    return p->quantum;
+  if(p->sched_queue < ROUND_ROBIN || p->sched_queue > FCFS)
+    return 1;
+  return queue_slice[p->sched_queue];
+}
+
+// CPU time p has used, in timer ticks, for the BJF rank.
+// Without a calibrated TSC, the number of dispatches.
+static double
+cputicks(struct proc *p)
+{
+  if(tsckhz == 0)
+    return p->executed_cycle;
+  return (double)(p->acct.utime + p->acct.stime) / (tsckhz * 10.0);
+}
+
 struct proc* 
 fcfs_scheduler(void)
 {
@@ -347,10 +587,8 @@ fcfs_scheduler(void)
   int label = 0;
   struct proc* created_sooner = 0;
 
-  for(p = ptable.proc ; p < &ptable.proc[NPROC]; p++)
+  for(p = ptable.runq[FCFS].head; p != 0; p = p->nextrun)
   {
-    if(p->state != RUNNABLE || p->sched_queue != FCFS)
-        continue;
 
     if(label == 0)
     {
@@ -377,21 +615,14 @@ priority_scheduler(void)
   int random_ticket = 0;
   struct proc* high_priority_order = 0;
 
-  for(p = ptable.proc ; p < &ptable.proc[NPROC]; p++)
+  for(p = ptable.runq[PRIORITY].head; p != 0; p = p->nextrun)
   {
-    if(p->state != RUNNABLE || p->sched_queue != PRIORITY)
-        continue;
-
 
-    if(label == 0)
+    // Ties go to the process queued first.
+    if(label == 0 || p->priority < random_ticket)
     {
       label = 1;
       random_ticket = p->priority;
-    }
-    
-    if( p->priority <= random_ticket && label == 1)
-    {
-      random_ticket = p->priority;
       high_priority_order = p;
     }
 
@@ -408,13 +639,11 @@ bjf_scheduler(void)
   int min_is_set = 0;
   struct proc* min_rank_process = 0;
 
-  for(p = ptable.proc ; p < &ptable.proc[NPROC]; p++)
+  for(p = ptable.runq[BJF].head; p != 0; p = p->nextrun)
   {
-    if(p->state != RUNNABLE || p->sched_queue != BJF)
-        continue;
     if (min_is_set == 1)
     {
-      cur_rank = ((1.0/p->priority)*p->priority_ratio)+(p->arrival_time*p->arrival_time_ratio)+(p->executed_cycle*0.1*p->executed_cycle_ratio);
+      cur_rank = ((1.0/p->priority)*p->priority_ratio)+(p->arrival_time*p->arrival_time_ratio)+(cputicks(p)*0.1*p->executed_cycle_ratio);
       if (cur_rank < min_rank)
       {
         min_rank = cur_rank;
@@ -424,7 +653,7 @@ bjf_scheduler(void)
     else
     {
       min_rank_process = p;
-      min_rank = ((1.0/p->priority)*p->priority_ratio)+(p->arrival_time*p->arrival_time_ratio)+(p->executed_cycle*0.1*p->executed_cycle_ratio);
+      min_rank = ((1.0/p->priority)*p->priority_ratio)+(p->arrival_time*p->arrival_time_ratio)+(cputicks(p)*0.1*p->executed_cycle_ratio);
       min_is_set = 1;
     }
   }
@@ -433,26 +662,13 @@ bjf_scheduler(void)
   return min_rank_process;
 }
 
+// The run queue is FIFO, and a process goes to its tail
+// whenever it becomes RUNNABLE, so taking the head is
+// round robin.
 struct proc* 
-round_robin_scheduler(int* index)
+round_robin_scheduler(void)
 {
-  struct proc *p;
-  int selected_index = -1;
-  int cur_index;
-  for (int i = 0; i < NPROC; i++)
-  {
-    cur_index = (i + (*index)) %  NPROC;
-    if(ptable.proc[cur_index].state != RUNNABLE || ptable.proc[cur_index].sched_queue != ROUND_ROBIN)
-      continue;
-
-    p = &ptable.proc[cur_index];
-    selected_index = cur_index;
-    *index = (cur_index + 1) % NPROC;
-    break;
-  }
-  if (selected_index == -1)
-    return 0;
-  return p;
+  return ptable.runq[ROUND_ROBIN].head;
 }
 
 //PAGEBREAK: 42
@@ -467,10 +683,11 @@ void
 scheduler(void)
 {
   struct proc *p;
-  struct proc *ap;
+  struct proc *ap, *next;
   struct cpu *c = mycpu();
+  uint64 now;
+  int q;
   c->proc = 0;
-  int RR_index = 0;
 
   for(;;){
     // Enable interrupts on this processor.
@@ -480,11 +697,10 @@ scheduler(void)
 
     acquire(&ptable.lock);
 
-    p = round_robin_scheduler(&RR_index);
+    p = round_robin_scheduler();
 
     if (p == 0)
     {
-      RR_index = 0;
       p = priority_scheduler();
     }
 
@@ -501,35 +717,52 @@ scheduler(void)
     {
       p->executed_cycle++;
 
-      for(ap = ptable.proc ; ap < &ptable.proc[NPROC]; ap++)
+      // Queues are visited from the top, so a process aged
+      // into a higher queue is not counted twice.
+      for(q = ROUND_ROBIN; q <= FCFS; q++)
       {
-        if(ap->pid == 0)
-          continue;
-
-        if(ap->state == RUNNABLE)
+        for(ap = ptable.runq[q].head; ap != 0; ap = next)
         {
+          next = ap->nextrun;
           ap->waiting_time++;
-        }
-      //  aging
-        if (ap->waiting_time > 10000)
-        {
-          if (ap->sched_queue > 1) 
+        //  aging
+          if (ap->waiting_time > 10000)
           {
-            ap->sched_queue--;
-            ap->waiting_time = 0;
+            if (ap->sched_queue > 1) 
+            {
+              setqueue(ap, ap->sched_queue - 1);
+              ap->waiting_time = 0;
+              trace(TR_AGING, ap->pid, ap->sched_queue);
+            }
           }
         }
       }
 
       p->waiting_time = 0;
+      p->slice = proc_slice(p);
+      p->resched = 0;
 
       c->proc = p;
 
       switchuvm(p);
+      runqdel(p);
       p->state = RUNNING;
+      now = rdtsc();
+      p->acct.wtime += now - p->stamp;
+      p->stamp = now;
+      trace(TR_RUN, p->sched_queue, 0);
 
       swtch(&(c->scheduler), p->context);
       switchkvm();
+      trace(TR_STOP, p->state, 0);
+
+      now = rdtsc();
+      p->acct.stime += now - p->stamp;
+      p->stamp = now;
+      if(p->state == RUNNABLE)
+        p->acct.nivcsw++;
+      else
+        p->acct.nvcsw++;
 
       c->proc = 0;
     }
@@ -560,7 +793,9 @@ sched(void)
   if(readeflags()&FL_IF)
     panic("sched interruptible");
   intena = mycpu()->intena;
+  heldrunning(p, 0);
   swtch(&p->context, mycpu()->scheduler);
+  heldrunning(p, 1);
   mycpu()->intena = intena;
 }
 
@@ -569,7 +804,7 @@ void
 yield(void)
 {
   acquire(&ptable.lock);  //DOC: yieldlock
-  myproc()->state = RUNNABLE;
+  setrunnable(myproc());
   sched();
   release(&ptable.lock);
 }
@@ -595,6 +830,33 @@ forkret(void)
   // Return to "caller", actually trapret (see allocproc).
 }
 
+// Add p, which is going to sleep, to the wait-channel hash
+// chain or timer wheel slot at head.  The ptable lock must
+// be held.
+static void
+chaninsert(struct proc **head, struct proc *p)
+{
+  p->nextchan = *head;
+  p->pprevchan = head;
+  if(*head)
+    (*head)->pprevchan = &p->nextchan;
+  *head = p;
+}
+
+// Take p off its hash chain or wheel slot, if it is on one.
+// The ptable lock must be held.
+static void
+chanremove(struct proc *p)
+{
+  if(p->pprevchan == 0)
+    return;
+  *p->pprevchan = p->nextchan;
+  if(p->nextchan)
+    p->nextchan->pprevchan = p->pprevchan;
+  p->nextchan = 0;
+  p->pprevchan = 0;
+}
+
 // Atomically release lock and sleep on chan.
 // Reacquires lock when awakened.
 void
@@ -621,6 +883,7 @@ sleep(void *chan, struct spinlock *lk)
   // Go to sleep.
   p->chan = chan;
   p->state = SLEEPING;
+  chaninsert(&ptable.chanhash[CHANHASH(chan)], p);
 
   sched();
 
@@ -634,17 +897,104 @@ sleep(void *chan, struct spinlock *lk)
   }
 }
 
+// Is p more urgent than q?  Lower queues come first, and
+// within the PRIORITY queue a lower priority value.
+static int
+urgent(struct proc *p, struct proc *q)
+{
+  if(p->sched_queue != q->sched_queue)
+    return p->sched_queue < q->sched_queue;
+  return p->sched_queue == PRIORITY && p->priority < q->priority;
+}
+
+// p has just become RUNNABLE.  If no CPU is idle and some
+// CPU runs a less urgent process, ask the least urgent one
+// to reschedule now instead of at its next timer tick.
+// The ptable lock must be held.
+static void
+preempt(struct proc *p)
+{
+  struct cpu *c, *victim;
+
+  victim = 0;
+  for(c = cpus; c < cpus+ncpu; c++){
+    if(c->proc == 0)
+      return;  // an idle CPU will pick p up
+    if(urgent(p, c->proc) && (victim == 0 || urgent(victim->proc, c->proc)))
+      victim = c;
+  }
+  if(victim == 0 || victim->proc->resched)
+    return;
+  victim->proc->resched = 1;
+  if(victim != mycpu())
+    lapicipi(victim->apicid, T_IRQ0 + IRQ_RESCHED);
+}
+
+// Make sleeping p RUNNABLE.  Its wait for a CPU starts now.
+// The ptable lock must be held.
+static void
+ready(struct proc *p)
+{
+  chanremove(p);
+  setrunnable(p);
+  p->stamp = rdtsc();
+  trace(TR_WAKEUP, p->pid, p->sched_queue);
+  preempt(p);
+}
+
 //PAGEBREAK!
 // Wake up all processes sleeping on chan.
 // The ptable lock must be held.
 static void
 wakeup1(void *chan)
 {
-  struct proc *p;
+  struct proc *p, *next;
 
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
-    if(p->state == SLEEPING && p->chan == chan)
-      p->state = RUNNABLE;
+  for(p = ptable.chanhash[CHANHASH(chan)]; p != 0; p = next){
+    next = p->nextchan;
+    if(p->state == SLEEPING && p->chan == chan){
+      ready(p);
+    }
+  }
+}
+
+// Sleep for n clock ticks.  The process is made RUNNABLE
+// just once, by timertick(), when its deadline has passed.
+// Returns -1 if the process has been killed.
+int
+sleepticks(uint n)
+{
+  struct proc *p = myproc();
+
+  acquire(&ptable.lock);
+  if(n > 0 && !p->killed){
+    p->wakeat = ticks + n;
+    p->chan = &p->wakeat;
+    p->state = SLEEPING;
+    chaninsert(&ptable.wheel[p->wakeat % NWHEEL], p);
+    sched();
+    p->chan = 0;
+  }
+  release(&ptable.lock);
+  return p->killed ? -1 : 0;
+}
+
+// Called by the timer interrupt after ticks has become now.
+// Wakes the processes in now's wheel slot whose deadline
+// has come.
+void
+timertick(uint now)
+{
+  struct proc *p, *next;
+
+  acquire(&ptable.lock);
+  for(p = ptable.wheel[now % NWHEEL]; p != 0; p = next){
+    next = p->nextchan;
+    if((int)(p->wakeat - now) <= 0){
+      ready(p);
+    }
+  }
+  release(&ptable.lock);
 }
 
 // Wake up all processes sleeping on chan.
@@ -665,24 +1015,82 @@ kill(int pid)
   struct proc *p;
 
   acquire(&ptable.lock);
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-    if(p->pid == pid){
-      p->killed = 1;
-      // Wake process from sleep if necessary.
-      if(p->state == SLEEPING)
-        p->state = RUNNABLE;
-      release(&ptable.lock);
-      return 0;
-    }
+  if((p = findproc(pid)) != 0){
+    p->killed = 1;
+    // Wake process from sleep if necessary.
+    if(p->state == SLEEPING)
+      ready(p);
+    release(&ptable.lock);
+    return 0;
   }
   release(&ptable.lock);
   return -1;
 }
 
+// A copy of the fields of a process that procdump() and
+// print_processes_details() print.
+struct psnap {
+  int pid;
+  enum procstate state;
+  char name[16];
+  int sched_queue;
+  int priority;
+  int priority_ratio;
+  int arrival_time_ratio;
+  int executed_cycle_ratio;
+  double rank;
+  int executed_cycle;
+  long int waiting_time;
+  uint pc[10];                 // where it sleeps, if SLEEPING
+};
+
+#define NSNAP (PGSIZE / sizeof(struct psnap))
+
+// Copy the NSNAP processes with the lowest pids above after
+// into ps, in pid order, and return how many were copied.
+// The copy is made under the ptable lock and printed after
+// releasing it: cprintf() must not be called with the ptable
+// lock held, and a walk without the lock could follow a proc
+// that has been freed.
+static int
+snapshot(struct psnap *ps, int after)
+{
+  struct proc *p;
+  struct psnap *s;
+  int i, n;
+
+  n = 0;
+  acquire(&ptable.lock);
+  for(p = ptable.all; p != 0; p = p->nextall){
+    if(p->pid <= after || (n == NSNAP && p->pid > ps[n-1].pid))
+      continue;
+    // Insert in pid order, dropping the highest if full.
+    i = n < NSNAP ? n++ : n - 1;
+    for(; i > 0 && ps[i-1].pid > p->pid; i--)
+      ps[i] = ps[i-1];
+    s = &ps[i];
+    s->pid = p->pid;
+    s->state = p->state;
+    safestrcpy(s->name, p->name, sizeof(s->name));
+    s->sched_queue = p->sched_queue;
+    s->priority = p->priority;
+    s->priority_ratio = p->priority_ratio;
+    s->arrival_time_ratio = p->arrival_time_ratio;
+    s->executed_cycle_ratio = p->executed_cycle_ratio;
+    s->rank = ((1.0/p->priority)*p->priority_ratio)+(p->arrival_time*p->arrival_time_ratio)+(cputicks(p)*0.1*p->executed_cycle_ratio);
+    s->executed_cycle = p->executed_cycle;
+    s->waiting_time = p->waiting_time;
+    s->pc[0] = 0;
+    if(p->state == SLEEPING)
+      getcallerpcs((uint*)p->context->ebp+2, s->pc);
+  }
+  release(&ptable.lock);
+  return n;
+}
+
 //PAGEBREAK: 36
 // Print a process listing to console.  For debugging.
 // Runs when user types ^P on console.
-// No lock to avoid wedging a stuck machine further.
 void
 procdump(void)
 {
@@ -694,162 +1102,188 @@ procdump(void)
   [RUNNING]   "run   ",
   [ZOMBIE]    "zombie"
   };
-  int i;
-  struct proc *p;
+  int i, j, n;
+  struct psnap *ps, *p;
   char *state;
-  uint pc[10];
 
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-    if(p->state == UNUSED)
-      continue;
-    if(p->state >= 0 && p->state < NELEM(states) && states[p->state])
-      state = states[p->state];
-    else
-      state = "???";
-    cprintf("%d %s %s", p->pid, state, p->name);
-    if(p->state == SLEEPING){
-      getcallerpcs((uint*)p->context->ebp+2, pc);
-      for(i=0; i<10 && pc[i] != 0; i++)
-        cprintf(" %p", pc[i]);
+  if((ps = (struct psnap*)kalloc()) == 0)
+    return;
+  for(n = snapshot(ps, 0); n > 0; n = snapshot(ps, ps[n-1].pid)){
+    for(j = 0; j < n; j++){
+      p = &ps[j];
+      if(p->state >= 0 && p->state < NELEM(states) && states[p->state])
+        state = states[p->state];
+      else
+        state = "???";
+      cprintf("%d %s %s", p->pid, state, p->name);
+      for(i=0; i<10 && p->pc[i] != 0; i++)
+        cprintf(" %p", p->pc[i]);
+      cprintf("\n");
     }
-    cprintf("\n");
   }
+  kfree((char*)ps);
 }
 
-void show_descendant(int parent_pid)
+static void
+fillinfo(struct procinfo *pi, struct proc *p, int depth)
 {
+  pi->pid = p->pid;
+  pi->ppid = p->parent ? p->parent->pid : 0;
+  pi->ctime = p->ctime;
+  pi->depth = depth;
+}
 
-  int have_descendant = 0;
-  int ids[30];
-  int d = 0;
-  int c,a = 0;
-  int crtime[30];
-  for(int i = 0; i < NPROC; i++)
-  {
-    if(ptable.proc[i].parent->pid == parent_pid)
-    {
-      
-      ids[d] = ptable.proc[i].pid;
-      crtime[d] = ptable.proc[i].ctime;
-      d++;
-      
-      have_descendant = 1;
-    }
-  }
+// Store up to n descendants of process pid in buf, in
+// depth-first order with the newest child first.  Returns
+// the number stored, or -1 if there is no such process.
+int
+descendants(int pid, struct procinfo *buf, int n)
+{
+  struct proc *root, *p;
+  int i, depth;
 
-  for(int m = 0; m < d; m++)
-  {
-    for(int n = m + 1; n < d; n++)
-    {
-      if(crtime[m] < crtime[n])
-      {
-        c = crtime[m];
-        a = ids[m];
-        crtime[m] = crtime[n];
-        ids[m] = ids[n];
-        crtime[n] = c;
-        ids[n] = a;
+  acquire(&ptable.lock);
+  if((root = findproc(pid)) == 0){
+    release(&ptable.lock);
+    return -1;
+  }
+  p = root;
+  depth = 0;
+  for(i = 0; i < n; i++){
+    if(p->children){
+      p = p->children;
+      depth++;
+    } else {
+      while(p != root && p->sibling == 0){
+        p = p->parent;
+        depth--;
       }
+      if(p == root)
+        break;
+      p = p->sibling;
     }
+    fillinfo(&buf[i], p, depth);
   }
-  for(int m = 0; m < d; m++)
-    cprintf("my id: %d, my child id: %d, my child creationtime: %d", parent_pid,ids[m],crtime[m]);
-
-  if(have_descendant)
-    cprintf("\n");
-  for(int m = 0; m < d; m++)
-    show_descendant(ids[m]);
-
+  release(&ptable.lock);
+  return i;
 }
 
-void show_ancestors(int my_pid)
+// Store up to n ancestors of process pid in buf, parent
+// first.  Returns the number stored, or -1 if there is no
+// such process.
+int
+ancestors(int pid, struct procinfo *buf, int n)
 {
+  struct proc *p;
+  int i;
 
-  for(int i = 0; i < NPROC; i++)
-  {
-    if(ptable.proc[i].pid == my_pid)
-    {
-      
-      cprintf("my id: %d, my parent id: %d, my parent creationtime: %d", my_pid,ptable.proc[i].parent->pid,my_pid,ptable.proc[i].parent->ctime);
-      cprintf("\n");
-      show_ancestors(ptable.proc[i].parent->pid);
-    }
+  acquire(&ptable.lock);
+  if((p = findproc(pid)) == 0){
+    release(&ptable.lock);
+    return -1;
   }
-
+  for(i = 0; i < n && p->parent != 0; i++){
+    p = p->parent;
+    fillinfo(&buf[i], p, i + 1);
+  }
+  release(&ptable.lock);
+  return i;
 }
 
 
-void sleep_process(void *chan)
+void change_sched_queue(int pid, int dst_queue)
 {
-  struct proc *p = myproc();
-  cprintf("my id: %d", p->pid );
-  if(p == 0)
-    panic("sleep");
-
+  struct proc* p;
 
-  // Go to sleep.
-  p->chan = chan;
-  p->state = SLEEPING;
+  if(!validqueue(dst_queue))
+    return;
+  acquire(&ptable.lock);
+  if((p = findproc(pid)) != 0)
+    setqueue(p, dst_queue);
+  release(&ptable.lock);
+}
 
-  // sched();
-  cprintf("my id: %d\n", p->pid );
 
 
-  // Tidy up.
-  p->chan = 0;
 
-  // Reacquire original lock.
-  // if(lk != &ptable.lock){  //DOC: sleeplock2
-  //   release(&ptable.lock);
-  //   // acquire(lk);
-  // }  
-}
-
-void change_sched_queue(int pid, int dst_queue)
+void set_ratio_process(int pid, int priority_ratio, int arrival_time_ratio, int executed_cycle_ratio)
 {
   struct proc* p;
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
+  acquire(&ptable.lock);
+  if((p = findproc(pid)) != 0)
   {
-    if(p->pid == pid)
-    {
-      p->sched_queue = dst_queue;
-      break;
-    }
+    p->priority_ratio = priority_ratio;
+    p->arrival_time_ratio = arrival_time_ratio;
+    p->executed_cycle_ratio = executed_cycle_ratio;
   }
+  release(&ptable.lock);
 }
 
 
+void set_priority(int pid, int priority)
+{
+  struct proc* p;
+  acquire(&ptable.lock);
+  if((p = findproc(pid)) != 0){
+    p->priority = priority;
+    setinfo(p);
+  }
+  release(&ptable.lock);
+}
 
+// Set the time slice of queue to ticks.
+int set_queue_slice(int queue, int ticks)
+{
+  if(queue < ROUND_ROBIN || queue > FCFS || ticks < 1)
+    return -1;
+  queue_slice[queue] = ticks;
+  return 0;
+}
 
-void set_ratio_process(int pid, int priority_ratio, int arrival_time_ratio, int executed_cycle_ratio)
+// Give process pid a time slice of its own, or go back to
+// its queue's with ticks == 0.
+int set_proc_slice(int pid, int ticks)
 {
   struct proc* p;
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
+
+  if(ticks < 0)
+    return -1;
+  acquire(&ptable.lock);
+  if((p = findproc(pid)) != 0)
   {
-    if(p->pid == pid)
-    {
-      p->priority_ratio = priority_ratio;
-      p->arrival_time_ratio = arrival_time_ratio;
-      p->executed_cycle_ratio = executed_cycle_ratio;
-      // cprintf("the new ratios  %d \nthe new ratios  %d \nthe new ratios  %d \n",
-      //         p->priority_ratio,p->arrival_time_ratio,p->executed_cycle_ratio);
-      break;
-    }
+    p->quantum = ticks;
+    release(&ptable.lock);
+    return 0;
   }
+  release(&ptable.lock);
+  return -1;
 }
 
-
-void set_priority(int pid, int priority)
+// Called on each timer interrupt taken while the current
+// process runs.  Returns 1 if it should give up the CPU:
+// its time slice is used up, or a higher queue has a
+// runnable process.
+int timeslice(void)
 {
-  struct proc* p;
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
+  struct proc *p = myproc();
+  int q, r;
+
+  if(--p->slice <= 0)
+    return 1;
+  if(p->sched_queue <= ROUND_ROBIN)
+    return 0;
+  r = 0;
+  acquire(&ptable.lock);
+  for(q = ROUND_ROBIN; q < p->sched_queue; q++)
   {
-    if(p->pid == pid)
+    if(ptable.runq[q].head != 0)
     {
-      p->priority = priority;
+      r = 1;
       break;
     }
   }
+  release(&ptable.lock);
+  return r;
 }
 
 
@@ -932,36 +1366,82 @@ int nod(int in)
 
 void print_processes_details(void)
 {
-  struct proc *p;
-  double rank;
+  struct psnap *ps, *p;
+  int j, n;
   char buf[16];
 
+  if((ps = (struct psnap*)kalloc()) == 0)
+    return;
+
   cprintf("name                pid   state       Qnum           priority   ratios           rank          exeCycle    waiting_time\n");
   cprintf("-----------------------------------------------------------------------------------------------------------------------\n");
 
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-
-    if(p->pid == 0)
-      continue;
-    
-    cprintf("%s", p->name);
-    for (int i = 0; i < 20 - strlen(p->name); i++) cprintf(" ");
-    cprintf("%d", p->pid);
-    for (int i = 0; i < 6 - nod(p->pid); i++) cprintf(" ");
-    cprintf("%s", get_state(p->state));
-    for (int i = 0; i < 12 - strlen(get_state(p->state)); i++) cprintf(" ");
-    cprintf("%s", get_Q_name(p->sched_queue));
-    for (int i = 0; i < 15 - strlen(get_Q_name(p->sched_queue)); i++) cprintf(" ");
-    cprintf("%d", p->priority);
-    for (int i = 0; i < 10 - nod(p->priority); i++) cprintf(" ");
-    cprintf("%d, %d, %d", p->priority_ratio, p->arrival_time_ratio, p->executed_cycle_ratio);
-    for (int i = 0; i < 13-nod(p->priority_ratio)-nod(p->arrival_time_ratio)-nod(p->executed_cycle_ratio); i++) cprintf(" ");
-    rank = ((1.0/p->priority)*p->priority_ratio)+(p->arrival_time*p->arrival_time_ratio)+(p->executed_cycle*0.1*p->executed_cycle_ratio);
-    cprintf("%s",double_to_string(rank, buf, 3));
-    for (int i = 0; i < 14 - strlen(buf); i++) cprintf(" ");
-    cprintf("%d", p->executed_cycle);
-    for (int i = 0; i < 12 - nod(p->executed_cycle); i++) cprintf(" ");
-    cprintf("%d\n", p->waiting_time);
+  for(n = snapshot(ps, 0); n > 0; n = snapshot(ps, ps[n-1].pid)){
+    for(j = 0; j < n; j++){
+      p = &ps[j];
+      cprintf("%s", p->name);
+      for (int i = 0; i < 20 - strlen(p->name); i++) cprintf(" ");
+      cprintf("%d", p->pid);
+      for (int i = 0; i < 6 - nod(p->pid); i++) cprintf(" ");
+      cprintf("%s", get_state(p->state));
+      for (int i = 0; i < 12 - strlen(get_state(p->state)); i++) cprintf(" ");
+      cprintf("%s", get_Q_name(p->sched_queue));
+      for (int i = 0; i < 15 - strlen(get_Q_name(p->sched_queue)); i++) cprintf(" ");
+      cprintf("%d", p->priority);
+      for (int i = 0; i < 10 - nod(p->priority); i++) cprintf(" ");
+      cprintf("%d, %d, %d", p->priority_ratio, p->arrival_time_ratio, p->executed_cycle_ratio);
+      for (int i = 0; i < 13-nod(p->priority_ratio)-nod(p->arrival_time_ratio)-nod(p->executed_cycle_ratio); i++) cprintf(" ");
+      cprintf("%s",double_to_string(p->rank, buf, 3));
+      for (int i = 0; i < 14 - strlen(buf); i++) cprintf(" ");
+      cprintf("%d", p->executed_cycle);
+      for (int i = 0; i < 12 - nod(p->executed_cycle); i++) cprintf(" ");
+      cprintf("%d\n", p->waiting_time);
+    }
   }
+  kfree((char*)ps);
 }
 
+// Charge the time since the current process's last accounting
+// event to user time, on entry to the kernel from user space
+// (fromuser is 1), or to system time, just before returning to
+// user space (fromuser is 0).
+void
+accttrap(int fromuser)
+{
+  struct proc *p = myproc();
+  uint64 now;
+
+  now = rdtsc();
+  if(fromuser)
+    p->acct.utime += now - p->stamp;
+  else
+    p->acct.stime += now - p->stamp;
+  p->stamp = now;
+}
+
+// Store the CPU usage of the current process, or of its
+// collected children, in *ru.
+int
+getrusage(int who, struct rusage *ru)
+{
+  struct proc *p = myproc();
+  struct acct a;
+
+  acquire(&ptable.lock);
+  if(who == RUSAGE_SELF)
+    a = p->acct;
+  else if(who == RUSAGE_CHILDREN)
+    a = p->cacct;
+  else {
+    release(&ptable.lock);
+    return -1;
+  }
+  release(&ptable.lock);
+
+  nstotimespec(tsctons(a.utime), &ru->utime);
+  nstotimespec(tsctons(a.stime), &ru->stime);
+  nstotimespec(tsctons(a.wtime), &ru->wtime);
+  ru->nvcsw = a.nvcsw;
+  ru->nivcsw = a.nivcsw;
+  return 0;
+}
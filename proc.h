@@ -32,16 +32,44 @@ struct context {
   uint eip;
 };
 
-void show_descendant(int parent_pid);
-void show_ancestors(int my_pid);
-void sleep_process(void *chan);
+struct rusage;
+struct procinfo;
+struct infopage;
+
+int descendants(int pid, struct procinfo *buf, int n);
+int ancestors(int pid, struct procinfo *buf, int n);
 void change_sched_queue(int pid, int dst_queue);
 void set_priority(int pid, int priority);
+int set_queue_slice(int queue, int ticks);
+int set_proc_slice(int pid, int ticks);
+int timeslice(void);
+void accttrap(int fromuser);
+int getrusage(int who, struct rusage *ru);
 void set_ratio_process(int pid, int priority_ratio, int arrival_time_ratio, int executed_cycle_ratio);
 void print_processes_details(void);
 
+// CPU usage of a process, in TSC cycles.
+struct acct {
+  uint64 utime;                // running in user space
+  uint64 stime;                // running in the kernel
+  uint64 wtime;                // RUNNABLE, waiting for a CPU
+  uint nvcsw;                  // gave up the CPU to sleep or exit
+  uint nivcsw;                 // preempted while still RUNNABLE
+};
+
 enum procstate { UNUSED, EMBRYO, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
 
+// A memory-mapped region created by mmap() (see mmap.c).
+// A slot is free when len is zero.
+struct vma {
+  uint addr;                   // Start of region (page aligned)
+  uint len;                    // Length of region (multiple of PGSIZE)
+  int prot;                    // PROT_READ, PROT_WRITE
+  int flags;                   // MAP_SHARED or MAP_PRIVATE, MAP_ANONYMOUS
+  struct file *f;              // Backing file, or 0 if anonymous
+  uint off;                    // Offset in f that addr maps
+};
+
 // Per-process state
 struct proc {
   uint sz;                     // Size of process memory (bytes)
@@ -50,13 +78,28 @@ struct proc {
   enum procstate state;        // Process state
   int pid;                     // Process ID
   struct proc *parent;         // Parent process
+  struct proc *children;       // First child
+  struct proc *sibling;        // Next child of parent
+  struct proc **pprevsibling;  // Link pointing at p among its siblings
+  struct proc *nextall;        // Next on the list of all processes
+  struct proc **pprevall;      // Link pointing at p on that list
+  struct proc *nexthash;       // Next on pid's hash chain
+  struct proc **pprevhash;     // Link pointing at p on that chain
+  struct proc *nextrun;        // Next on run queue, if RUNNABLE
+  struct proc **pprevrun;      // Link pointing at p on it, or 0
   struct trapframe *tf;        // Trap frame for current syscall
   struct context *context;     // swtch() here to run process
   void *chan;                  // If non-zero, sleeping on chan
+  struct proc *nextchan;       // Next on chan's wait-channel hash chain
+  struct proc **pprevchan;     // Link pointing at p on that chain, or 0
+  uint wakeat;                 // Tick to wake at, in sleepticks()
   int killed;                  // If non-zero, have been killed
   struct file *ofile[NOFILE];  // Open files
   struct inode *cwd;           // Current directory
+  struct vma vma[NVMA];        // Memory-mapped regions
   char name[16];               // Process name (debugging)
+  struct infopage *info;       // Mapped read-only at INFOPAGE
+  struct sleeplock *held;      // Sleep locks held exclusively
   int ctime;                  // adding creation time
   int sched_queue;
   int priority;
@@ -68,6 +111,14 @@ struct proc {
   long int arrival_time;
   int executed_cycle;
   long int waiting_time;
+
+  int quantum;                 // Own time slice in ticks, or 0 for the queue's
+  int slice;                   // Ticks left in the current time slice
+  int resched;                 // More urgent work is runnable; yield soon
+
+  struct acct acct;            // CPU usage
+  struct acct cacct;           // CPU usage of children collected by wait()
+  uint64 stamp;                // TSC at the last accounting event
 };
 
 // Process memory is laid out contiguously, low addresses first:
@@ -0,0 +1,19 @@
+// A process in the process tree, from get_descendant() or
+// get_ancestors().
+struct procinfo {
+  int pid;
+  int ppid;    // parent's pid, or 0 for init
+  int ctime;   // creation time, in ticks
+  int depth;   // generations below or above the pid asked about
+};
+
+// The info page, mapped read-only at INFOPAGE in each process
+// so that user code can read these without a system call (see
+// ulib.c).  The kernel keeps it up to date.  Time is on the
+// time page (see date.h).
+struct infopage {
+  int pid;
+  int ctime;        // creation time, in ticks
+  int sched_queue;  // ROUND_ROBIN, PRIORITY, BJF or FCFS
+  int priority;
+};
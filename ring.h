@@ -0,0 +1,40 @@
+// The system call ring, a page mapped read-write at RINGPAGE
+// by the first ring_enter() a process makes.  User code
+// queues operations at sq[sqtail % NRING] and advances
+// sqtail; ring_enter() runs them and posts each result at
+// cq[cqtail % NRING].  Results are what the corresponding
+// system call would return.  fork copies the ring; exec
+// discards it.
+#define NRING        128
+
+#define RING_READ    1   // read(fd, addr, n)
+#define RING_WRITE   2   // write(fd, addr, n)
+#define RING_OPEN    3   // open(addr, n)
+#define RING_CLOSE   4   // close(fd)
+#define RING_FSTAT   5   // fstat(fd, addr)
+
+#define RING_LASTFD  0x1 // fd is the result of the last RING_OPEN
+                         // run by the same ring_enter()
+
+struct sqe {
+  ushort op;             // RING_READ, ...
+  ushort flags;          // RING_LASTFD
+  int fd;
+  uint addr;             // buffer, or path for RING_OPEN
+  int n;                 // byte count, or mode for RING_OPEN
+  uint data;             // copied to the completion
+};
+
+struct cqe {
+  uint data;             // from the sqe
+  int res;
+};
+
+struct ring {
+  volatile uint sqhead;  // next sqe to run; advanced by the kernel
+  volatile uint sqtail;  // next free sqe; advanced by user code
+  volatile uint cqhead;  // next cqe to read; advanced by user code
+  volatile uint cqtail;  // next free cqe; advanced by the kernel
+  struct sqe sq[NRING];
+  struct cqe cq[NRING];
+};
@@ -0,0 +1,11 @@
+// CPU usage, from getrusage().  Include date.h first.
+#define RUSAGE_SELF      0   // the calling process
+#define RUSAGE_CHILDREN  1   // its children that wait() has collected
+
+struct rusage {
+  struct timespec utime;  // time running in user space
+  struct timespec stime;  // time running in the kernel
+  struct timespec wtime;  // time runnable, waiting for a CPU
+  uint nvcsw;             // voluntary context switches
+  uint nivcsw;            // involuntary context switches
+};
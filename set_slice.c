@@ -0,0 +1,24 @@
+#include "types.h"
+#include "user.h"
+#include "fcntl.h"
+
+// set_slice -q queue ticks   set the time slice of a queue
+// set_slice pid ticks        set a process's own time slice,
+//                            or drop it with ticks 0
+int main(int argc, char* argv[])
+{
+    int r;
+
+    if (argc == 4 && strcmp(argv[1], "-q") == 0)
+        r = set_slice(atoi(argv[2]), 0, atoi(argv[3]));
+    else if (argc == 3)
+        r = set_slice(0, atoi(argv[1]), atoi(argv[2]));
+    else
+    {
+        printf(1, "usage: set_slice -q queue ticks | set_slice pid ticks\n");
+        exit();
+    }
+    if (r < 0)
+        printf(1, "set_slice failed\n");
+    exit();
+}
@@ -0,0 +1,167 @@
+// Object caches.
+//
+// A slabcache hands out objects of one size, carved out of
+// kalloc() pages called slabs.  A slab starts with a struct
+// slab that links its free objects.  In front of the slabs
+// each CPU has a magazine of recently freed objects, which
+// it uses with interrupts off but without a lock.  The
+// cache's lock is taken only to refill an empty magazine or
+// to empty a full one, half a magazine at a time.  A slab
+// whose objects are all free goes back to kalloc(), unless
+// it is the cache's only such slab.
+//
+// Objects keep what the constructor set up while they sit in
+// a cache, so a lock in an object stays valid across free
+// and reallocation.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "proc.h"
+#include "spinlock.h"
+#include "slab.h"
+
+struct slab {
+  struct slab *next;   // in the cache's partial list
+  struct slab *prev;
+  void *free;          // free objects, linked through their first word
+  uint nfree;
+};
+
+#define SLABHDR ((sizeof(struct slab) + 7) & ~7)
+
+void
+slabinit(struct slabcache *c, char *name, uint size, void (*ctor)(void*))
+{
+  initlock(&c->lock, "slab");
+  c->name = name;
+  c->size = (size + 7) & ~7;
+  c->perslab = (PGSIZE - SLABHDR) / c->size;
+  if(c->perslab == 0)
+    panic("slabinit");
+  c->ctor = ctor;
+  c->partial = 0;
+  c->nempty = 0;
+  memset(c->mag, 0, sizeof(c->mag));
+}
+
+static void
+delpartial(struct slabcache *c, struct slab *s)
+{
+  if(s->prev)
+    s->prev->next = s->next;
+  else
+    c->partial = s->next;
+  if(s->next)
+    s->next->prev = s->prev;
+}
+
+static void
+addpartial(struct slabcache *c, struct slab *s)
+{
+  s->prev = 0;
+  s->next = c->partial;
+  if(c->partial)
+    c->partial->prev = s;
+  c->partial = s;
+}
+
+// Make a new slab of free objects.  Caller holds c->lock.
+static struct slab*
+grow(struct slabcache *c)
+{
+  struct slab *s;
+  char *obj;
+  uint i;
+
+  if((s = (struct slab*)kalloc()) == 0)
+    return 0;
+  s->free = 0;
+  s->nfree = c->perslab;
+  obj = (char*)s + SLABHDR + (c->perslab - 1) * c->size;
+  for(i = 0; i < c->perslab; i++, obj -= c->size){
+    if(c->ctor)
+      c->ctor(obj);
+    *(void**)obj = s->free;
+    s->free = obj;
+  }
+  addpartial(c, s);
+  c->nempty++;
+  return s;
+}
+
+// Take an object from the slabs.  Caller holds c->lock.
+static void*
+take(struct slabcache *c)
+{
+  struct slab *s;
+  void *obj;
+
+  if((s = c->partial) == 0 && (s = grow(c)) == 0)
+    return 0;
+  if(s->nfree == c->perslab)
+    c->nempty--;
+  obj = s->free;
+  s->free = *(void**)obj;
+  if(--s->nfree == 0)
+    delpartial(c, s);
+  return obj;
+}
+
+// Return obj to its slab.  Caller holds c->lock.
+static void
+put(struct slabcache *c, void *obj)
+{
+  struct slab *s;
+
+  s = (struct slab*)PGROUNDDOWN((uint)obj);
+  *(void**)obj = s->free;
+  s->free = obj;
+  if(s->nfree++ == 0)
+    addpartial(c, s);
+  if(s->nfree == c->perslab){
+    if(c->nempty > 0){
+      delpartial(c, s);
+      kfree((char*)s);
+    } else
+      c->nempty++;
+  }
+}
+
+void*
+slaballoc(struct slabcache *c)
+{
+  struct magazine *m;
+  void *obj;
+
+  pushcli();
+  m = &c->mag[cpuid()];
+  if(m->n == 0){
+    acquire(&c->lock);
+    while(m->n < MAGSIZE/2 && (obj = take(c)) != 0)
+      m->obj[m->n++] = obj;
+    release(&c->lock);
+  }
+  obj = m->n > 0 ? m->obj[--m->n] : 0;
+  popcli();
+  return obj;
+}
+
+void
+slabfree(struct slabcache *c, void *obj)
+{
+  struct magazine *m;
+
+  pushcli();
+  m = &c->mag[cpuid()];
+  if(m->n == MAGSIZE){
+    acquire(&c->lock);
+    while(m->n > MAGSIZE/2)
+      put(c, m->obj[--m->n]);
+    release(&c->lock);
+  }
+  m->obj[m->n++] = obj;
+  popcli();
+}
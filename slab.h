@@ -0,0 +1,20 @@
+// Object caches (see slab.c).
+// Include spinlock.h and param.h first.
+
+#define MAGSIZE 16  // objects in a per-CPU magazine
+
+struct magazine {
+  int n;
+  void *obj[MAGSIZE];
+};
+
+struct slabcache {
+  struct spinlock lock;  // protects the slab lists
+  char *name;
+  uint size;             // object size, a multiple of 8
+  uint perslab;          // objects per slab
+  void (*ctor)(void*);   // run once on each new object, or 0
+  struct slab *partial;  // slabs with some free objects
+  int nempty;            // slabs with every object free
+  struct magazine mag[NCPU];
+};
@@ -9,6 +9,11 @@
 #include "proc.h"
 #include "spinlock.h"
 #include "sleeplock.h"
+#include "lockstat.h"
+
+// How many times a waiter spins, at most, on a lock whose
+// holder is running on another CPU before going to sleep.
+#define SPINLIMIT 1000
 
 void
 initsleeplock(struct sleeplock *lk, char *name)
@@ -16,31 +21,144 @@ initsleeplock(struct sleeplock *lk, char *name)
   initlock(&lk->lk, "sleep lock");
   lk->name = name;
   lk->locked = 0;
+  lk->readers = 0;
+  lk->rwait = 0;
+  lk->wwait = 0;
   lk->pid = 0;
+  lk->proc = 0;
+  lk->running = 0;
+  lk->nextheld = 0;
+  lk->class = lockclass(name, LS_SLEEP);
 }
 
+// If lk is held exclusively by a process that is running
+// on another CPU, it will likely release it sooner than a
+// sleep/wakeup round trip takes: spin a little while, with
+// lk->lk released, and return 1.  Otherwise return 0.
+// Only lk itself is read: the holder's proc may be freed.
+static int
+spinwait(struct sleeplock *lk)
+{
+  int i;
+
+  if(!lk->locked || lk->proc == myproc() || !lk->running)
+    return 0;
+  release(&lk->lk);
+  for(i = 0; i < SPINLIMIT; i++){
+    if(!lk->locked || !lk->running)
+      break;
+    pause();
+  }
+  acquire(&lk->lk);
+  return 1;
+}
+
+// Called by sched() with running 0 before p gives up its
+// CPU, and with running 1 when it has it back, to tell
+// waiters on the locks p holds whether spinning is worth it.
+void
+heldrunning(struct proc *p, int running)
+{
+  struct sleeplock *lk;
+
+  for(lk = p->held; lk != 0; lk = lk->nextheld)
+    lk->running = running;
+}
+
+// Acquire lk exclusively.
 void
 acquiresleep(struct sleeplock *lk)
 {
+  uint64 start;
+  int spun, waited;
+
   acquire(&lk->lk);
-  while (lk->locked) {
+  start = rdtsc();
+  spun = waited = 0;
+  while (lk->locked || lk->readers) {
+    waited = 1;
+    if(!spun && spinwait(lk)){
+      spun = 1;
+      continue;
+    }
+    lk->wwait++;
     sleep(lk, &lk->lk);
+    lk->wwait--;
   }
   lk->locked = 1;
   lk->pid = myproc()->pid;
+  lk->proc = myproc();
+  lk->running = 1;
+  lk->nextheld = myproc()->held;
+  myproc()->held = lk;
+  lk->start = rdtsc();
+  lockstatacquire(lk->class, (uint)__builtin_return_address(0),
+                  waited, waited ? lk->start - start : 0);
   release(&lk->lk);
 }
 
 void
 releasesleep(struct sleeplock *lk)
 {
+  struct sleeplock **pp;
+
   acquire(&lk->lk);
+  lockstatrelease(lk->class, rdtsc() - lk->start);
+  for(pp = &myproc()->held; *pp != 0; pp = &(*pp)->nextheld){
+    if(*pp == lk){
+      *pp = lk->nextheld;
+      break;
+    }
+  }
   lk->locked = 0;
   lk->pid = 0;
-  wakeup(lk);
+  lk->proc = 0;
+  lk->running = 0;
+  lk->nextheld = 0;
+  if(lk->rwait || lk->wwait)
+    wakeup(lk);
+  release(&lk->lk);
+}
+
+// Acquire lk shared with other readers.
+void
+acquiresleepshared(struct sleeplock *lk)
+{
+  uint64 start;
+  int spun, waited;
+
+  acquire(&lk->lk);
+  start = rdtsc();
+  spun = waited = 0;
+  while (lk->locked || lk->wwait) {
+    waited = 1;
+    if(!spun && spinwait(lk)){
+      spun = 1;
+      continue;
+    }
+    lk->rwait++;
+    sleep(lk, &lk->lk);
+    lk->rwait--;
+  }
+  lk->readers++;
+  lockstatacquire(lk->class, (uint)__builtin_return_address(0),
+                  waited, waited ? rdtsc() - start : 0);
   release(&lk->lk);
 }
 
+void
+releasesleepshared(struct sleeplock *lk)
+{
+  acquire(&lk->lk);
+  if(lk->readers < 1)
+    panic("releasesleepshared");
+  lk->readers--;
+  if(lk->readers == 0 && lk->wwait)
+    wakeup(lk);
+  release(&lk->lk);
+}
+
+// Is the current process holding lk exclusively?
 int
 holdingsleep(struct sleeplock *lk)
 {
@@ -51,6 +169,3 @@ holdingsleep(struct sleeplock *lk)
   release(&lk->lk);
   return r;
 }
-
-
-
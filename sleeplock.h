@@ -1,10 +1,23 @@
-// Long-term locks for processes
+// Long-term locks for processes.
+// Held either exclusively by one process, or shared by
+// any number of readers.  Waiting writers keep new readers
+// out, so that readers cannot starve them.
 struct sleeplock {
-  uint locked;       // Is the lock held?
+  uint locked;       // Is the lock held exclusively?
+  int readers;       // Number of shared holders
+  int rwait;         // Readers sleeping on the lock
+  int wwait;         // Writers sleeping on the lock
   struct spinlock lk; // spinlock protecting this sleep lock
   
   // For debugging:
   char *name;        // Name of lock.
   int pid;           // Process holding lock
+  struct proc *proc; // Process holding lock exclusively
+  volatile int running;       // Exclusive holder is on a CPU
+  struct sleeplock *nextheld; // Next lock on holder's p->held
+
+  // Profiling, see lockstat.c.
+  struct lockclass *class;  // Shared by locks with this name.
+  uint64 start;             // TSC when acquired.
 };
 
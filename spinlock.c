@@ -8,13 +8,23 @@
 #include "mmu.h"
 #include "proc.h"
 #include "spinlock.h"
+#include "lockstat.h"
+
+// pause instructions a waiter executes, per CPU ahead of it
+// in line, between looks at the lock.
+#define BACKOFF 32
 
 void
 initlock(struct spinlock *lk, char *name)
 {
   lk->name = name;
-  lk->locked = 0;
+  lk->next = 0;
+  lk->owner = 0;
   lk->cpu = 0;
+  lk->nacquire = 0;
+  lk->ncontend = 0;
+  lk->spin = 0;
+  lk->class = lockclass(name, LS_SPIN);
 }
 
 // Acquire the lock.
@@ -24,13 +34,30 @@ initlock(struct spinlock *lk, char *name)
 void
 acquire(struct spinlock *lk)
 {
+  uint ticket, ahead;
+  uint64 start, wait;
+  int i;
+
   pushcli(); // disable interrupts to avoid deadlock.
   if(holding(lk))
     panic("acquire");
 
-  // The xchg is atomic.
-  while(xchg(&lk->locked, 1) != 0)
-    ;
+  // Take a ticket; the xadd is atomic.  Waiters only read
+  // owner, and back off longer the further back in line
+  // they are, so the lock's cache line is not hammered.
+  ticket = xadd(&lk->next, 1);
+  start = rdtsc();
+  wait = 0;
+  if(lk->owner != ticket){
+    while((ahead = ticket - lk->owner) != 0)
+      for(i = ahead * BACKOFF; i > 0; i--)
+        pause();
+    lk->start = rdtsc();
+    wait = lk->start - start;
+    lk->ncontend++;
+    lk->spin += wait;
+  } else
+    lk->start = start;
 
   // Tell the C compiler and the processor to not move loads or stores
   // past this point, to ensure that the critical section's memory
@@ -38,8 +65,12 @@ acquire(struct spinlock *lk)
   __sync_synchronize();
 
   // Record info about lock acquisition for debugging.
+  lk->nacquire++;
   lk->cpu = mycpu();
+#ifdef LOCKDEBUG
   getcallerpcs(&lk, lk->pcs);
+#endif
+  lockstatacquire(lk->class, (uint)__builtin_return_address(0), wait != 0, wait);
 }
 
 // Release the lock.
@@ -49,7 +80,10 @@ release(struct spinlock *lk)
   if(!holding(lk))
     panic("release");
 
+  lockstatrelease(lk->class, rdtsc() - lk->start);
+#ifdef LOCKDEBUG
   lk->pcs[0] = 0;
+#endif
   lk->cpu = 0;
 
   // Tell the C compiler and the processor to not move loads or stores
@@ -59,10 +93,10 @@ release(struct spinlock *lk)
   // stores; __sync_synchronize() tells them both not to.
   __sync_synchronize();
 
-  // Release the lock, equivalent to lk->locked = 0.
-  // This code can't use a C assignment, since it might
-  // not be atomic. A real OS would use C atomics here.
-  asm volatile("movl $0, %0" : "+m" (lk->locked) : );
+  // Serve the next ticket, equivalent to lk->owner++.
+  // Only the holder writes owner, so the increment need not
+  // be locked, but it must be a single store.
+  asm volatile("incl %0" : "+m" (lk->owner) : : "memory");
 
   popcli();
 }
@@ -91,7 +125,7 @@ holding(struct spinlock *lock)
 {
   int r;
   pushcli();
-  r = lock->locked && lock->cpu == mycpu();
+  r = lock->owner != lock->next && lock->cpu == mycpu();
   popcli();
   return r;
 }
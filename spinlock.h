@@ -1,11 +1,23 @@
 // Mutual exclusion lock.
+// A ticket lock: CPUs are served in the order they arrive.
 struct spinlock {
-  uint locked;       // Is the lock held?
+  uint next;             // Next ticket to hand out.
+  volatile uint owner;   // Ticket being served; held if != next.
 
   // For debugging:
   char *name;        // Name of lock.
   struct cpu *cpu;   // The cpu holding the lock.
+#ifdef LOCKDEBUG
   uint pcs[10];      // The call stack (an array of program counters)
                      // that locked the lock.
-};
+#endif
+
+  // Contention statistics, updated while holding the lock.
+  uint nacquire;     // Number of acquisitions.
+  uint ncontend;     // Acquisitions that had to wait.
+  uint64 spin;       // TSC cycles spent waiting.
 
+  // Profiling, see lockstat.c.
+  struct lockclass *class;  // Shared by locks with this name.
+  uint64 start;             // TSC when acquired.
+};
@@ -4,11 +4,22 @@
 void*
 memset(void *dst, int c, uint n)
 {
-  if ((int)dst%4 == 0 && n%4 == 0){
-    c &= 0xFF;
-    stosl(dst, (c<<24)|(c<<16)|(c<<8)|c, n/4);
-  } else
-    stosb(dst, c, n);
+  char *d;
+  uint m;
+
+  d = dst;
+  c &= 0xFF;
+  if(n >= 16){
+    // Fill up to a long boundary, then a long at a time.
+    m = -(uint)d % 4;
+    stosb(d, c, m);
+    d += m;
+    n -= m;
+    stosl(d, (c<<24)|(c<<16)|(c<<8)|c, n/4);
+    d += n & ~3;
+    n %= 4;
+  }
+  stosb(d, c, n);
   return dst;
 }
 
@@ -33,18 +44,33 @@ memmove(void *dst, const void *src, uint n)
 {
   const char *s;
   char *d;
+  uint m;
 
   s = src;
   d = dst;
+  if(n == 0)
+    return dst;
   if(s < d && s + n > d){
-    s += n;
-    d += n;
-    while(n-- > 0)
-      *--d = *--s;
-  } else
-    while(n-- > 0)
-      *d++ = *s++;
-
+    // Overlap with dst above src: copy from the end down.
+    if(((uint)s | (uint)d | n) % 4 == 0)
+      movslback(d + n - 4, s + n - 4, n/4);
+    else
+      movsbback(d + n - 1, s + n - 1, n);
+    return dst;
+  }
+  if(n >= 16 && ((uint)s ^ (uint)d) % 4 == 0){
+    // Same alignment: bytes up to a long boundary, then longs.
+    m = -(uint)d % 4;
+    movsb(d, s, m);
+    d += m;
+    s += m;
+    n -= m;
+    movsl(d, s, n/4);
+    d += n & ~3;
+    s += n & ~3;
+    n %= 4;
+  }
+  movsb(d, s, n);
   return dst;
 }
 
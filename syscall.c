@@ -6,6 +6,7 @@
 #include "proc.h"
 #include "x86.h"
 #include "syscall.h"
+#include "trace.h"
 
 // User code makes a system call with INT T_SYSCALL.
 // System call number in %eax.
@@ -27,7 +28,9 @@ fetchint(uint addr, int *ip)
 
 // Fetch the nul-terminated string at addr from the current process.
 // Doesn't actually copy the string - just sets *pp to point at it.
-// Returns length of string, not including nul.
+// Returns length of string, not including nul.  The string must be
+// in the heap, below sz, which mmap() regions never overlap, so no
+// other process can change it.
 int
 fetchstr(uint addr, char **pp)
 {
@@ -45,6 +48,24 @@ fetchstr(uint addr, char **pp)
   return -1;
 }
 
+// Copy the nul-terminated string at addr in the current process's
+// heap into buf, which holds max bytes.  Returns length of string,
+// not including nul, or -1 if it does not fit.
+int
+copyinstr(uint addr, char *buf, int max)
+{
+  struct proc *curproc = myproc();
+  int i;
+
+  for(i = 0; i < max; i++){
+    if(addr + i < addr || addr + i >= curproc->sz)
+      return -1;
+    if((buf[i] = *(char*)(addr + i)) == 0)
+      return i;
+  }
+  return -1;
+}
+
 // Fetch the nth 32-bit system call argument.
 int
 argint(int n, int *ip)
@@ -52,34 +73,64 @@ argint(int n, int *ip)
   return fetchint((myproc()->tf->esp) + 4 + 4*n, ip);
 }
 
-// Fetch the nth word-sized system call argument as a pointer
-// to a block of memory of size bytes.  Check that the pointer
-// lies within the process address space.
+// Check that the block of memory of size bytes at addr, which
+// the kernel will store to if write is set, lies within the
+// process address space: either the heap or a mapped region,
+// whose pages are faulted in here so the kernel never has to.
 int
-argptr(int n, char **pp, int size)
+fetchbuf(uint addr, int size, int write)
 {
-  int i;
   struct proc *curproc = myproc();
+
+  if(size < 0)
+    return -1;
+  if(addr >= curproc->sz || addr+size > curproc->sz){
+    if(mmapprefault(curproc, addr, size, write) < 0)
+      return -1;
+  }
+  return 0;
+}
+
+// Fetch the nth word-sized system call argument as a pointer
+// to a block of memory of size bytes, checked by fetchbuf().
+static int
+fetchptr(int n, char **pp, int size, int write)
+{
+  int i;
  
   if(argint(n, &i) < 0)
     return -1;
-  if(size < 0 || (uint)i >= curproc->sz || (uint)i+size > curproc->sz)
+  if(fetchbuf(i, size, write) < 0)
     return -1;
   *pp = (char*)i;
   return 0;
 }
 
-// Fetch the nth word-sized system call argument as a string pointer.
-// Check that the pointer is valid and the string is nul-terminated.
-// (There is no shared writable memory, so the string can't change
-// between this check and being used by the kernel.)
+// Fetch the nth word-sized system call argument as a pointer
+// to a block of memory of size bytes that the kernel reads.
+int
+argptr(int n, char **pp, int size)
+{
+  return fetchptr(n, pp, size, 0);
+}
+
+// Like argptr, for a block of memory the kernel writes.
+int
+argptrw(int n, char **pp, int size)
+{
+  return fetchptr(n, pp, size, 1);
+}
+
+// Fetch the nth word-sized system call argument as a string pointer
+// and copy the string into buf, which holds max bytes, so that the
+// kernel works on a copy user code cannot change.
 int
-argstr(int n, char **pp)
+argstr(int n, char *buf, int max)
 {
   int addr;
   if(argint(n, &addr) < 0)
     return -1;
-  return fetchstr(addr, pp);
+  return copyinstr(addr, buf, max);
 }
 
 extern int sys_chdir(void);
@@ -112,6 +163,15 @@ extern int sys_change_queue(void);
 extern int sys_set_priority(void);
 extern int sys_set_ratio_process(void);
 extern int sys_print_processes_details(void);
+extern int sys_mmap(void);
+extern int sys_munmap(void);
+extern int sys_pipesize(void);
+extern int sys_splice(void);
+extern int sys_clock_gettime(void);
+extern int sys_set_slice(void);
+extern int sys_getrusage(void);
+extern int sys_tracedrain(void);
+extern int sys_ring_enter(void);
 
 static int (*syscalls[])(void) = {
 [SYS_fork]    sys_fork,
@@ -144,6 +204,15 @@ static int (*syscalls[])(void) = {
 [SYS_set_priority] sys_set_priority,
 [SYS_set_ratio_process] sys_set_ratio_process,
 [SYS_print_processes_details] sys_print_processes_details,
+[SYS_mmap]    sys_mmap,
+[SYS_munmap]  sys_munmap,
+[SYS_pipesize] sys_pipesize,
+[SYS_splice]  sys_splice,
+[SYS_clock_gettime] sys_clock_gettime,
+[SYS_set_slice] sys_set_slice,
+[SYS_getrusage] sys_getrusage,
+[SYS_tracedrain] sys_tracedrain,
+[SYS_ring_enter] sys_ring_enter,
 };
 
 void
@@ -154,7 +223,9 @@ syscall(void)
 
   num = curproc->tf->eax;
   if(num > 0 && num < NELEM(syscalls) && syscalls[num]) {
+    trace(TR_SYSCALL, num, 0);
     curproc->tf->eax = syscalls[num]();
+    trace(TR_SYSRET, num, curproc->tf->eax);
   } else {
     cprintf("%d %s: unknown sys call %d\n",
             curproc->pid, curproc->name, num);
@@ -28,4 +28,13 @@
 #define SYS_change_queue 27
 #define SYS_set_priority 28
 #define SYS_set_ratio_process 29
-#define SYS_print_processes_details 30
\ No newline at end of file
+#define SYS_print_processes_details 30
+#define SYS_mmap   31
+#define SYS_munmap 32
+#define SYS_pipesize 33
+#define SYS_splice 34
+#define SYS_clock_gettime 35
+#define SYS_set_slice 36
+#define SYS_getrusage 37
+#define SYS_tracedrain 38
+#define SYS_ring_enter 39
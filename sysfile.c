@@ -15,6 +15,17 @@
 #include "sleeplock.h"
 #include "file.h"
 #include "fcntl.h"
+#include "memlayout.h"
+#include "ring.h"
+
+// Return the open file for descriptor fd, or 0.
+static struct file*
+fdfile(int fd)
+{
+  if(fd < 0 || fd >= NOFILE)
+    return 0;
+  return myproc()->ofile[fd];
+}
 
 // Fetch the nth word-sized system call argument as a file descriptor
 // and return both the descriptor and the corresponding struct file.
@@ -26,7 +37,7 @@ argfd(int n, int *pfd, struct file **pf)
 
   if(argint(n, &fd) < 0)
     return -1;
-  if(fd < 0 || fd >= NOFILE || (f=myproc()->ofile[fd]) == 0)
+  if((f = fdfile(fd)) == 0)
     return -1;
   if(pfd)
     *pfd = fd;
@@ -73,7 +84,7 @@ sys_read(void)
   int n;
   char *p;
 
-  if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argptr(1, &p, n) < 0)
+  if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argptrw(1, &p, n) < 0)
     return -1;
   return fileread(f, p, n);
 }
@@ -90,26 +101,35 @@ sys_write(void)
   return filewrite(f, p, n);
 }
 
-int
-sys_close(void)
+static int
+closefd(int fd)
 {
-  int fd;
   struct file *f;
 
-  if(argfd(0, &fd, &f) < 0)
+  if((f = fdfile(fd)) == 0)
     return -1;
   myproc()->ofile[fd] = 0;
   fileclose(f);
   return 0;
 }
 
+int
+sys_close(void)
+{
+  int fd;
+
+  if(argint(0, &fd) < 0)
+    return -1;
+  return closefd(fd);
+}
+
 int
 sys_fstat(void)
 {
   struct file *f;
   struct stat *st;
 
-  if(argfd(0, 0, &f) < 0 || argptr(1, (void*)&st, sizeof(*st)) < 0)
+  if(argfd(0, 0, &f) < 0 || argptrw(1, (void*)&st, sizeof(*st)) < 0)
     return -1;
   return filestat(f, st);
 }
@@ -118,10 +138,10 @@ sys_fstat(void)
 int
 sys_link(void)
 {
-  char name[DIRSIZ], *new, *old;
+  char name[DIRSIZ], new[MAXPATH], old[MAXPATH];
   struct inode *dp, *ip;
 
-  if(argstr(0, &old) < 0 || argstr(1, &new) < 0)
+  if(argstr(0, old, sizeof(old)) < 0 || argstr(1, new, sizeof(new)) < 0)
     return -1;
 
   begin_op();
@@ -186,10 +206,10 @@ sys_unlink(void)
 {
   struct inode *ip, *dp;
   struct dirent de;
-  char name[DIRSIZ], *path;
+  char name[DIRSIZ], path[MAXPATH];
   uint off;
 
-  if(argstr(0, &path) < 0)
+  if(argstr(0, path, sizeof(path)) < 0)
     return -1;
 
   begin_op();
@@ -282,17 +302,13 @@ create(char *path, short type, short major, short minor)
   return ip;
 }
 
-int
-sys_open(void)
+static int
+openfile(char *path, int omode)
 {
-  char *path;
-  int fd, omode;
+  int fd;
   struct file *f;
   struct inode *ip;
 
-  if(argstr(0, &path) < 0 || argint(1, &omode) < 0)
-    return -1;
-
   begin_op();
 
   if(omode & O_CREATE){
@@ -332,14 +348,25 @@ sys_open(void)
   return fd;
 }
 
+int
+sys_open(void)
+{
+  char path[MAXPATH];
+  int omode;
+
+  if(argstr(0, path, sizeof(path)) < 0 || argint(1, &omode) < 0)
+    return -1;
+  return openfile(path, omode);
+}
+
 int
 sys_mkdir(void)
 {
-  char *path;
+  char path[MAXPATH];
   struct inode *ip;
 
   begin_op();
-  if(argstr(0, &path) < 0 || (ip = create(path, T_DIR, 0, 0)) == 0){
+  if(argstr(0, path, sizeof(path)) < 0 || (ip = create(path, T_DIR, 0, 0)) == 0){
     end_op();
     return -1;
   }
@@ -352,11 +379,11 @@ int
 sys_mknod(void)
 {
   struct inode *ip;
-  char *path;
+  char path[MAXPATH];
   int major, minor;
 
   begin_op();
-  if((argstr(0, &path)) < 0 ||
+  if((argstr(0, path, sizeof(path))) < 0 ||
      argint(1, &major) < 0 ||
      argint(2, &minor) < 0 ||
      (ip = create(path, T_DEV, major, minor)) == 0){
@@ -371,12 +398,12 @@ sys_mknod(void)
 int
 sys_chdir(void)
 {
-  char *path;
+  char path[MAXPATH];
   struct inode *ip;
   struct proc *curproc = myproc();
   
   begin_op();
-  if(argstr(0, &path) < 0 || (ip = namei(path)) == 0){
+  if(argstr(0, path, sizeof(path)) < 0 || (ip = namei(path)) == 0){
     end_op();
     return -1;
   }
@@ -396,11 +423,11 @@ sys_chdir(void)
 int
 sys_exec(void)
 {
-  char *path, *argv[MAXARG];
+  char path[MAXPATH], *argv[MAXARG];
   int i;
   uint uargv, uarg;
 
-  if(argstr(0, &path) < 0 || argint(1, (int*)&uargv) < 0){
+  if(argstr(0, path, sizeof(path)) < 0 || argint(1, (int*)&uargv) < 0){
     return -1;
   }
   memset(argv, 0, sizeof(argv));
@@ -426,7 +453,7 @@ sys_pipe(void)
   struct file *rf, *wf;
   int fd0, fd1;
 
-  if(argptr(0, (void*)&fd, 2*sizeof(fd[0])) < 0)
+  if(argptrw(0, (void*)&fd, 2*sizeof(fd[0])) < 0)
     return -1;
   if(pipealloc(&rf, &wf) < 0)
     return -1;
@@ -442,3 +469,125 @@ sys_pipe(void)
   fd[1] = fd1;
   return 0;
 }
+
+int
+sys_mmap(void)
+{
+  int addr, len, prot, flags, off;
+  struct file *f;
+
+  if(argint(0, &addr) < 0 || argint(1, &len) < 0 || argint(2, &prot) < 0 ||
+     argint(3, &flags) < 0 || argint(5, &off) < 0)
+    return -1;
+  f = 0;
+  if((flags & MAP_ANONYMOUS) == 0 && argfd(4, 0, &f) < 0)
+    return -1;
+  if(len <= 0 || off < 0)
+    return -1;
+  // addr is only a hint, and is ignored.
+  return mmap(len, prot, flags, f, off);
+}
+
+int
+sys_munmap(void)
+{
+  int addr, len;
+
+  if(argint(0, &addr) < 0 || argint(1, &len) < 0 || len <= 0)
+    return -1;
+  return munmap(addr, len);
+}
+
+// Resize the ring of the pipe open on fd; 0 just returns
+// the current size.
+int
+sys_pipesize(void)
+{
+  struct file *f;
+  int n;
+
+  if(argfd(0, 0, &f) < 0 || argint(1, &n) < 0)
+    return -1;
+  if(f->type != FD_PIPE)
+    return -1;
+  return pipesize(f->pipe, n);
+}
+
+// Move up to n bytes from fd_in to fd_out inside the kernel.
+// One of the two must be a pipe.
+int
+sys_splice(void)
+{
+  struct file *fin, *fout;
+  int n;
+
+  if(argfd(0, 0, &fin) < 0 || argfd(1, 0, &fout) < 0 || argint(2, &n) < 0)
+    return -1;
+  return filesplice(fin, fout, n);
+}
+
+// Run one operation from the system call ring, checking it
+// as the system call it stands for would.  lastfd is for
+// RING_LASTFD.
+static int
+ringop(struct sqe *e, int lastfd)
+{
+  struct file *f;
+  char path[MAXPATH];
+  int fd;
+
+  fd = (e->flags & RING_LASTFD) ? lastfd : e->fd;
+  switch(e->op){
+  case RING_READ:
+    if((f = fdfile(fd)) == 0 || fetchbuf(e->addr, e->n, 1) < 0)
+      return -1;
+    return fileread(f, (char*)e->addr, e->n);
+  case RING_WRITE:
+    if((f = fdfile(fd)) == 0 || fetchbuf(e->addr, e->n, 0) < 0)
+      return -1;
+    return filewrite(f, (char*)e->addr, e->n);
+  case RING_OPEN:
+    if(copyinstr(e->addr, path, sizeof(path)) < 0)
+      return -1;
+    return openfile(path, e->n);
+  case RING_CLOSE:
+    return closefd(fd);
+  case RING_FSTAT:
+    if((f = fdfile(fd)) == 0 || fetchbuf(e->addr, sizeof(struct stat), 1) < 0)
+      return -1;
+    return filestat(f, (struct stat*)e->addr);
+  }
+  return -1;
+}
+
+// Map the system call ring if need be, then run up to n
+// operations queued on it, in order, posting each result.
+// Stops early when no operation is queued or there is no
+// room for a result.  Returns the number run.
+int
+sys_ring_enter(void)
+{
+  struct ring *r = (struct ring*)RINGPAGE;
+  struct sqe e;
+  struct cqe *c;
+  int n, i, res, lastfd;
+
+  if(argint(0, &n) < 0 || n < 0 || mapring(myproc()->pgdir) < 0)
+    return -1;
+  lastfd = -1;
+  for(i = 0; i < n && !myproc()->killed; i++){
+    if(r->sqhead == r->sqtail || r->cqtail - r->cqhead >= NRING)
+      break;
+    // Copy the entry, since user code can still change it.
+    e = r->sq[r->sqhead % NRING];
+    r->sqhead++;
+    res = ringop(&e, lastfd);
+    if(e.op == RING_OPEN)
+      lastfd = res;
+    c = &r->cq[r->cqtail % NRING];
+    c->data = e.data;
+    c->res = res;
+    r->cqtail++;
+  }
+  return i;
+}
@@ -2,6 +2,9 @@
 #include "x86.h"
 #include "defs.h"
 #include "date.h"
+#include "rusage.h"
+#include "trace.h"
+#include "procinfo.h"
 #include "param.h"
 #include "memlayout.h"
 #include "mmu.h"
@@ -60,21 +63,12 @@ int
 sys_sleep(void)
 {
   int n;
-  uint ticks0;
 
   if(argint(0, &n) < 0)
     return -1;
-  acquire(&tickslock);
-  ticks0 = ticks;
-  while(ticks - ticks0 < n){
-    if(myproc()->killed){
-      release(&tickslock);
-      return -1;
-    }
-    sleep(&ticks, &tickslock);
-  }
-  release(&tickslock);
-  return 0;
+  if(n < 0)
+    n = 0;
+  return sleepticks(n);
 }
 
 // return how many clock tick interrupts have occurred
@@ -90,24 +84,68 @@ sys_uptime(void)
   return xticks;
 }
 
+// Store up to n descendants of a process in a buffer.
 int sys_get_descendant(void)
 {
-  int parent_id;
+  int pid, n;
+  struct procinfo *buf;
 
-  if(argint(0, &parent_id) < 0)
+  if(argint(0, &pid) < 0 || argint(2, &n) < 0 ||
+     n < 0 || n > USERTOP / sizeof(*buf) ||
+     argptrw(1, (char**)&buf, n * sizeof(*buf)) < 0)
     return -1;
-  show_descendant(parent_id);
-  return 1;
+  return descendants(pid, buf, n);
 }
 
+// Store up to n ancestors of a process in a buffer.
 int sys_get_ancestors(void)
 {
-  int my_id;
+  int pid, n;
+  struct procinfo *buf;
 
-  if(argint(0, &my_id) < 0)
+  if(argint(0, &pid) < 0 || argint(2, &n) < 0 ||
+     n < 0 || n > USERTOP / sizeof(*buf) ||
+     argptrw(1, (char**)&buf, n * sizeof(*buf)) < 0)
     return -1;
-  show_ancestors(my_id);
-  return 1;
+  return ancestors(pid, buf, n);
+}
+
+// Store the time since boot, in ns, in a struct timespec.
+int
+sys_clock_gettime(void)
+{
+  struct timespec *ts;
+
+  if(argptrw(0, (char**)&ts, sizeof(*ts)) < 0)
+    return -1;
+  nstotimespec(nanotime(), ts);
+  return 0;
+}
+
+// Store the CPU usage of the process or of its children
+// in a struct rusage.
+int
+sys_getrusage(void)
+{
+  int who;
+  struct rusage *ru;
+
+  if(argint(0, &who) < 0 || argptrw(1, (char**)&ru, sizeof(*ru)) < 0)
+    return -1;
+  return getrusage(who, ru);
+}
+
+// Move up to n kernel trace events to a buffer.
+int
+sys_tracedrain(void)
+{
+  int n;
+  struct trevent *buf;
+
+  if(argint(1, &n) < 0 || n < 0 || n > USERTOP / sizeof(*buf) ||
+     argptrw(0, (char**)&buf, n * sizeof(*buf)) < 0)
+    return -1;
+  return tracedrain(buf, n);
 }
 
 int sys_get_creation_time(void)
@@ -139,26 +177,16 @@ int sys_sleep_time(void)
 {
   
   struct proc *curproc = myproc();
-  int n = curproc->tf->edx;
-  // int n;
-  int ticks0 = 0;
+  int n = curproc->tf->edx;  // sleep_time() passes n in %edx
+
   cprintf("my time bafor sleep: %d\n", ticks );
   cprintf("my id bafor sleep: %d\n", curproc->pid );
-  if(argint(0, &n) < 0)
+  if(n < 0)
+    n = 0;
+  if(sleepticks(n) < 0)
     return -1;
-  // acquire(&tickslock);
-
-  while(ticks0 < n){
-    if(curproc->killed){
-      // release(&tickslock);
-      return -1;
-    }
-    sleep_process(&ticks);
-    ticks0 ++;
-  }
   cprintf("my id after sleep: %d\n", myproc()->pid );
   cprintf("my time after sleep: %d\n", ticks );
-  // release(&tickslock);
   return 0;
 }
 
@@ -217,6 +245,18 @@ int sys_set_priority(void)
   return 1;
 }
 
+int sys_set_slice(void)
+{
+  int queue, pid, ticks;
+
+  if(argint(0, &queue) < 0 || argint(1, &pid) < 0 || argint(2, &ticks) < 0)
+    return -1;
+
+  if(queue != 0)
+    return set_queue_slice(queue, ticks);
+  return set_proc_slice(pid, ticks);
+}
+
 int sys_print_processes_details(void)
 {
   print_processes_details();
@@ -0,0 +1,62 @@
+// time cmd [args...]: run cmd and report the time it took
+// and the CPU time it used.
+
+#include "types.h"
+#include "user.h"
+#include "date.h"
+#include "rusage.h"
+
+// Print t as seconds with three decimals.
+static void
+prtime(char *what, struct timespec *t)
+{
+  uint ms = t->tv_nsec / 1000000;
+
+  printf(2, "%s %d.%s%s%d\n", what, t->tv_sec,
+         ms < 100 ? "0" : "", ms < 10 ? "0" : "", ms);
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct timespec start, end;
+  struct rusage ru;
+  int pid;
+
+  if(argc < 2){
+    printf(2, "usage: time cmd [args...]\n");
+    exit();
+  }
+
+  uclock_gettime(&start);
+  pid = fork();
+  if(pid < 0){
+    printf(2, "time: fork failed\n");
+    exit();
+  }
+  if(pid == 0){
+    exec(argv[1], argv + 1);
+    printf(2, "time: exec %s failed\n", argv[1]);
+    exit();
+  }
+  wait();
+  uclock_gettime(&end);
+
+  if(end.tv_nsec < start.tv_nsec){
+    end.tv_sec--;
+    end.tv_nsec += 1000000000;
+  }
+  end.tv_sec -= start.tv_sec;
+  end.tv_nsec -= start.tv_nsec;
+  prtime("real", &end);
+
+  if(getrusage(RUSAGE_CHILDREN, &ru) < 0){
+    printf(2, "time: getrusage failed\n");
+    exit();
+  }
+  prtime("user", &ru.utime);
+  prtime("sys ", &ru.stime);
+  prtime("wait", &ru.wtime);
+  printf(2, "csw  %d voluntary, %d involuntary\n", ru.nvcsw, ru.nivcsw);
+  exit();
+}
@@ -0,0 +1,98 @@
+// Kernel event tracing.
+//
+// Each CPU appends fixed-size events to its own ring, with
+// interrupts off, so recording takes no lock: the CPU is the
+// only writer of its ring's head, and tracedrain() is the only
+// writer of its tail.  When a ring is full new events are
+// dropped and counted, so a drained trace is never torn.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "x86.h"
+#include "proc.h"
+#include "spinlock.h"
+#include "trace.h"
+
+#define TRSIZE 4096 // events per CPU; a power of 2
+
+struct trring {
+  volatile uint head;  // next event to write
+  volatile uint tail;  // next event to drain
+  uint lost;           // events dropped since the last drain
+  struct trevent ev[TRSIZE];
+};
+
+static struct trring rings[NCPU];
+static struct spinlock drainlock;
+
+void
+traceinit(void)
+{
+  initlock(&drainlock, "trace");
+}
+
+// Record an event on this CPU's ring.
+void
+trace(int type, uint a, uint b)
+{
+  struct cpu *c;
+  struct trring *r;
+  struct trevent *e;
+  uint h;
+
+  pushcli();
+  c = mycpu();
+  r = &rings[c - cpus];
+  h = r->head;
+  if(h - r->tail >= TRSIZE){
+    __sync_fetch_and_add(&r->lost, 1);
+    popcli();
+    return;
+  }
+  e = &r->ev[h & (TRSIZE-1)];
+  e->tsc = rdtsc();
+  e->type = type;
+  e->cpu = c - cpus;
+  e->pid = c->proc ? c->proc->pid : 0;
+  e->a = a;
+  e->b = b;
+  __sync_synchronize();
+  r->head = h + 1;
+  popcli();
+}
+
+// Move up to n events from the rings to buf, CPU by CPU.
+// Returns the number of events moved.
+int
+tracedrain(struct trevent *buf, int n)
+{
+  struct trring *r;
+  struct trevent *e;
+  uint h;
+  int i;
+
+  i = 0;
+  acquire(&drainlock);
+  for(r = rings; r < &rings[ncpu] && i < n; r++){
+    if(r->lost){
+      e = &buf[i++];
+      memset(e, 0, sizeof(*e));
+      e->type = TR_LOST;
+      e->cpu = r - rings;
+      e->tsc = rdtsc();
+      e->a = __sync_lock_test_and_set(&r->lost, 0);
+    }
+    h = r->head;
+    __sync_synchronize();
+    for(; r->tail != h && i < n; i++){
+      buf[i] = r->ev[r->tail & (TRSIZE-1)];
+      __sync_synchronize();
+      r->tail++;
+    }
+  }
+  release(&drainlock);
+  return i;
+}
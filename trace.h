@@ -0,0 +1,22 @@
+// Kernel trace events, read with tracedrain() (see trace.c).
+#define TR_RUN        1   // scheduler runs pid; a: queue
+#define TR_STOP       2   // pid gives up the CPU; a: new state
+#define TR_WAKEUP     3   // a: pid made RUNNABLE, b: its queue
+#define TR_AGING      4   // a: pid moved by aging, b: new queue
+#define TR_DISKREQ    5   // a: block queued, b: 1 for a write
+#define TR_DISKDONE   6   // a: block done
+#define TR_BEGINOP    7   // a: blocks reserved, b: outstanding ops
+#define TR_COMMIT     8   // a: blocks in the transaction
+#define TR_COMMITDONE 9
+#define TR_SYSCALL    10  // a: system call number
+#define TR_SYSRET     11  // a: system call number, b: return value
+#define TR_LOST       12  // a: events dropped because the ring was full
+
+struct trevent {
+  uint64 tsc;     // TSC when the event was recorded
+  ushort type;
+  ushort cpu;
+  int pid;        // process running on cpu, or 0
+  uint a;
+  uint b;
+};
@@ -36,6 +36,9 @@ idtinit(void)
 void
 trap(struct trapframe *tf)
 {
+  if(myproc() && (tf->cs&3) == DPL_USER)
+    accttrap(1);
+
   if(tf->trapno == T_SYSCALL){
     if(myproc()->killed)
       exit();
@@ -43,6 +46,17 @@ trap(struct trapframe *tf)
     syscall();
     if(myproc()->killed)
       exit();
+    if(myproc()->resched)
+      yield();
+    accttrap(0);
+    return;
+  }
+
+  // A user process single-stepping into sysenter traps on the
+  // first instruction of sysentry, in the kernel, since
+  // sysenter leaves FL_TF alone.  Stop stepping.
+  if(tf->trapno == T_DEBUG && (tf->cs&3) == 0){
+    tf->eflags &= ~FL_TF;
     return;
   }
 
@@ -51,8 +65,9 @@ trap(struct trapframe *tf)
     if(cpuid() == 0){
       acquire(&tickslock);
       ticks++;
-      wakeup(&ticks);
       release(&tickslock);
+      tsctick(ticks);
+      timertick(ticks);
     }
     lapiceoi();
     break;
@@ -71,6 +86,10 @@ trap(struct trapframe *tf)
     uartintr();
     lapiceoi();
     break;
+  case T_IRQ0 + IRQ_RESCHED:
+    // Sent by preempt() in proc.c; the yield is below.
+    lapiceoi();
+    break;
   case T_IRQ0 + 7:
   case T_IRQ0 + IRQ_SPURIOUS:
     cprintf("cpu%d: spurious interrupt at %x:%x\n",
@@ -79,6 +98,12 @@ trap(struct trapframe *tf)
     break;
 
   //PAGEBREAK: 13
+  case T_PGFLT:
+    // A user access to a memory-mapped page not yet filled in?
+    if(myproc() && (tf->cs&3) == DPL_USER &&
+       mmapfault(myproc(), rcr2(), tf->err & FEC_WR) == 0)
+      break;
+    // Otherwise a real fault; fall through.
   default:
     if(myproc() == 0 || (tf->cs&3) == 0){
       // In kernel, it must be our mistake.
@@ -100,13 +125,17 @@ trap(struct trapframe *tf)
   if(myproc() && myproc()->killed && (tf->cs&3) == DPL_USER)
     exit();
 
-  // Force process to give up CPU on clock tick.
+  // Force process to give up CPU when its time slice is over.
   // If interrupts were on while locks held, would need to check nlock.
+  // Also give it up at once when a wakeup has asked for it.
   if(myproc() && myproc()->state == RUNNING &&
-     tf->trapno == T_IRQ0+IRQ_TIMER)
+     (myproc()->resched || (tf->trapno == T_IRQ0+IRQ_TIMER && timeslice())))
     yield();
 
   // Check if the process has been killed since we yielded
   if(myproc() && myproc()->killed && (tf->cs&3) == DPL_USER)
     exit();
+
+  if(myproc() && (tf->cs&3) == DPL_USER)
+    accttrap(0);
 }
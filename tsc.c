@@ -0,0 +1,157 @@
+// High-resolution clock.
+//
+// At boot, tscinit() measures the TSC frequency against
+// channel 2 of the 8254 PIT.  On every timer interrupt CPU 0
+// records in the time page the TSC value and nanoseconds
+// since boot, so that converting a later TSC value only
+// needs a short multiply and shift.  The time page is mapped
+// read-only into every process at TIMEPAGE.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "x86.h"
+#include "date.h"
+
+#define PIT_CH2   0x42      // channel 2 data port
+#define PIT_MODE  0x43      // mode/command port
+#define PIT_GATE  0x61      // channel 2 gate and output
+#define PIT_HZ    1193182   // PIT input clock
+#define CALMS     10        // calibration interval in ms
+#define SHIFT     24        // fraction bits in timepage mult
+#define TICKNS    10000000  // ns per timer tick, without a TSC
+
+static struct timepage *tp;
+uint tsckhz;                // TSC frequency, or 0 if unknown
+
+// Divide n by d.  The quotient must fit in 32 bits.
+static uint
+div64(uint64 n, uint d, uint *rem)
+{
+  uint q, r;
+
+  asm("divl %4" : "=a" (q), "=d" (r) :
+      "a" ((uint)n), "d" ((uint)(n >> 32)), "rm" (d));
+  if(rem)
+    *rem = r;
+  return q;
+}
+
+// Convert TSC cycles to ns with the time page's mult.
+static uint64
+cyc2ns(uint64 cyc)
+{
+  return ((cyc >> 32) * tp->mult << (32 - SHIFT)) +
+         ((uint64)(uint)cyc * tp->mult >> SHIFT);
+}
+
+// Count TSC cycles while the PIT counts down CALMS ms.
+static uint
+calibrate(void)
+{
+  uint64 start, end;
+  uint count;
+
+  // Gate channel 2 on, speaker off, one-shot countdown.
+  outb(PIT_GATE, (inb(PIT_GATE) & ~0x02) | 0x01);
+  outb(PIT_MODE, 0xB0);
+  count = PIT_HZ * CALMS / 1000;
+  outb(PIT_CH2, count & 0xFF);
+  outb(PIT_CH2, count >> 8);
+
+  start = rdtsc();
+  // OUT2 goes high when the count reaches zero.  Give up
+  // if it has not after 2^31 cycles: there is no PIT.
+  do {
+    end = rdtsc();
+    if(end - start >= 0x80000000)
+      return 0;
+  } while((inb(PIT_GATE) & 0x20) == 0);
+  return (uint)(end - start) / CALMS;
+}
+
+void
+tscinit(void)
+{
+  if((tp = (struct timepage*)kalloc()) == 0)
+    panic("tscinit");
+  memset(tp, 0, PGSIZE);
+
+  tsckhz = calibrate();
+  if(tsckhz >= (1000000 >> (32 - SHIFT))){
+    tp->mult = div64((uint64)1000000 << SHIFT, tsckhz, 0);
+    tp->shift = SHIFT;
+  } else
+    tsckhz = 0;
+  tp->base_tsc = rdtsc();
+  tp->sysenter = sysenterok();
+  if(tsckhz)
+    cprintf("tsc: %d kHz\n", tsckhz);
+}
+
+// Map the time page read-only at TIMEPAGE in pgdir.
+int
+maptimepage(pde_t *pgdir)
+{
+  kdup((char*)tp);
+  if(mappages(pgdir, (char*)TIMEPAGE, PGSIZE, V2P(tp), PTE_U) < 0){
+    kfree((char*)tp);
+    return -1;
+  }
+  return 0;
+}
+
+// Called on CPU 0 by every timer interrupt.
+void
+tsctick(uint ticks)
+{
+  uint64 now;
+
+  now = rdtsc();
+  tp->seq++;
+  __sync_synchronize();
+  if(tp->mult)
+    tp->base_ns += cyc2ns(now - tp->base_tsc);
+  else
+    tp->base_ns += TICKNS;
+  tp->base_tsc = now;
+  tp->ticks = ticks;
+  __sync_synchronize();
+  tp->seq++;
+}
+
+// Convert a count of TSC cycles to ns, or 0 without a
+// calibrated TSC.
+uint64
+tsctons(uint64 cyc)
+{
+  return tp->mult ? cyc2ns(cyc) : 0;
+}
+
+// Nanoseconds since boot.
+uint64
+nanotime(void)
+{
+  uint seq;
+  uint64 ns;
+
+  do {
+    while((seq = tp->seq) & 1)
+      pause();
+    __sync_synchronize();
+    ns = tp->base_ns;
+    if(tp->mult)
+      ns += cyc2ns(rdtsc() - tp->base_tsc);
+    __sync_synchronize();
+  } while(tp->seq != seq);
+  return ns;
+}
+
+// Split ns into a struct timespec.
+void
+nstotimespec(uint64 ns, struct timespec *ts)
+{
+  ts->tv_sec = div64(ns, 1000000000, &ts->tv_nsec);
+}
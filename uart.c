@@ -1,4 +1,8 @@
 // Intel 8250 serial port (UART).
+//
+// Output goes through a ring that the transmit-empty
+// interrupt drains, up to a FIFO's worth of bytes at a
+// time, so that writers do not wait for the line.
 
 #include "types.h"
 #include "defs.h"
@@ -14,15 +18,65 @@
 
 #define COM1    0x3f8
 
+#define IER     1       // interrupt enable
+#define  IER_RX   0x01  //   received data available
+#define  IER_TX   0x02  //   transmit holding register empty
+#define IIR     2       // interrupt identification (read)
+#define  IIR_NONE 0x01  //   no interrupt pending
+#define  IIR_ID   0x0E
+#define  IIR_MSR  0x00  //   modem status
+#define  IIR_TX   0x02
+#define  IIR_LSR  0x06  //   line status
+#define FCR     2       // FIFO control (write)
+#define LSR     5       // line status
+#define  LSR_RX   0x01  //   data ready
+#define  LSR_TX   0x20  //   transmit holding register empty
+#define MSR     6       // modem status
+
+#define FIFOSIZE 16     // bytes the transmit FIFO takes at once
+#define TXSIZE   1024   // a power of 2
+
 static int uart;    // is there a uart?
 
+static struct {
+  struct spinlock lock;
+  char buf[TXSIZE];
+  uint r;  // next byte to send
+  uint w;  // next free slot
+} tx;
+
+// Wait for the transmitter to be ready for another byte.
+static void
+txwait(void)
+{
+  int i;
+
+  for(i = 0; i < 128 && !(inb(COM1+LSR) & LSR_TX); i++)
+    microdelay(10);
+}
+
+// Fill the transmit FIFO from the ring, if it is empty.
+// Caller must hold tx.lock.
+static void
+txstart(void)
+{
+  int i;
+
+  if(!(inb(COM1+LSR) & LSR_TX))
+    return;
+  for(i = 0; i < FIFOSIZE && tx.r != tx.w; i++)
+    outb(COM1+0, tx.buf[tx.r++ % TXSIZE]);
+}
+
 void
 uartinit(void)
 {
   char *p;
 
-  // Turn off the FIFO
-  outb(COM1+2, 0);
+  initlock(&tx.lock, "uart");
+
+  // Enable and clear the FIFOs.
+  outb(COM1+FCR, 0x07);
 
   // 9600 baud, 8 data bits, 1 stop bit, parity off.
   outb(COM1+3, 0x80);    // Unlock divisor
@@ -30,16 +84,16 @@ uartinit(void)
   outb(COM1+1, 0);
   outb(COM1+3, 0x03);    // Lock divisor, 8 data bits.
   outb(COM1+4, 0);
-  outb(COM1+1, 0x01);    // Enable receive interrupts.
+  outb(COM1+IER, IER_RX|IER_TX);
 
   // If status is 0xFF, no serial port.
-  if(inb(COM1+5) == 0xFF)
+  if(inb(COM1+LSR) == 0xFF)
     return;
   uart = 1;
 
   // Acknowledge pre-existing interrupt conditions;
   // enable interrupts.
-  inb(COM1+2);
+  inb(COM1+IIR);
   inb(COM1+0);
   ioapicenable(IRQ_COM1, 0);
 
@@ -48,15 +102,47 @@ uartinit(void)
     uartputc(*p);
 }
 
+// Queue n bytes for output.  If the ring is full, wait
+// for the line instead of dropping output.
+void
+uartwrite(char *s, int n)
+{
+  if(!uart)
+    return;
+  acquire(&tx.lock);
+  while(n > 0){
+    if(tx.w - tx.r == TXSIZE){
+      txwait();
+      txstart();
+      continue;
+    }
+    tx.buf[tx.w++ % TXSIZE] = *s++;
+    n--;
+  }
+  txstart();
+  release(&tx.lock);
+}
+
 void
 uartputc(int c)
 {
-  int i;
+  char ch = c;
+
+  uartwrite(&ch, 1);
+}
 
+// Output c at once, after whatever the ring holds, without
+// locks or interrupts.  For early boot and panic().
+void
+uartputcsync(int c)
+{
   if(!uart)
     return;
-  for(i = 0; i < 128 && !(inb(COM1+5) & 0x20); i++)
-    microdelay(10);
+  while(tx.r != tx.w){
+    txwait();
+    outb(COM1+0, tx.buf[tx.r++ % TXSIZE]);
+  }
+  txwait();
   outb(COM1+0, c);
 }
 
@@ -65,7 +151,7 @@ uartgetc(void)
 {
   if(!uart)
     return -1;
-  if(!(inb(COM1+5) & 0x01))
+  if(!(inb(COM1+LSR) & LSR_RX))
     return -1;
   return inb(COM1+0);
 }
@@ -73,5 +159,29 @@ uartgetc(void)
 void
 uartintr(void)
 {
-  consoleintr(uartgetc);
+  int i, iir;
+
+  // The interrupt line stays raised while any condition is
+  // pending, so handle them all before returning.
+  for(i = 0; i < 16; i++){
+    iir = inb(COM1+IIR);
+    if(iir & IIR_NONE)
+      break;
+    switch(iir & IIR_ID){
+    case IIR_TX:
+      acquire(&tx.lock);
+      txstart();
+      release(&tx.lock);
+      break;
+    case IIR_LSR:
+      inb(COM1+LSR);
+      break;
+    case IIR_MSR:
+      inb(COM1+MSR);
+      break;
+    default:  // received data, or a FIFO timeout
+      consoleintr(uartgetc);
+      break;
+    }
+  }
 }
@@ -3,6 +3,49 @@
 #include "fcntl.h"
 #include "user.h"
 #include "x86.h"
+#include "memlayout.h"
+#include "date.h"
+#include "ring.h"
+#include "procinfo.h"
+
+// Replaced by printf.c's when a program links it.
+void __attribute__((weak))
+fflushall(void)
+{
+}
+
+void __attribute__((weak))
+fdrelease(int fd)
+{
+}
+
+int
+fork(void)
+{
+  fflushall();
+  return _fork();
+}
+
+int
+exit(void)
+{
+  fflushall();
+  _exit();
+}
+
+int
+exec(char *path, char **argv)
+{
+  fflushall();
+  return _exec(path, argv);
+}
+
+int
+close(int fd)
+{
+  fdrelease(fd);
+  return _close(fd);
+}
 
 char*
 strcpy(char *s, const char *t)
@@ -36,7 +79,21 @@ strlen(const char *s)
 void*
 memset(void *dst, int c, uint n)
 {
-  stosb(dst, c, n);
+  char *d;
+  uint m;
+
+  d = dst;
+  c &= 0xFF;
+  if(n >= 16){
+    m = -(uint)d % 4;
+    stosb(d, c, m);
+    d += m;
+    n -= m;
+    stosl(d, (c<<24)|(c<<16)|(c<<8)|c, n/4);
+    d += n & ~3;
+    n %= 4;
+  }
+  stosb(d, c, n);
   return dst;
 }
 
@@ -55,6 +112,7 @@ gets(char *buf, int max)
   int i, cc;
   char c;
 
+  fflushall();  // show any prompt before waiting for input
   for(i=0; i+1 < max; ){
     cc = read(0, &c, 1);
     if(cc < 1)
@@ -97,21 +155,147 @@ memmove(void *vdst, const void *vsrc, int n)
 {
   char *dst;
   const char *src;
+  int m;
 
   dst = vdst;
   src = vsrc;
-  while(n-- > 0)
-    *dst++ = *src++;
+  if(n <= 0)
+    return vdst;
+  if(src < dst && src + n > dst){
+    if(((uint)src | (uint)dst | n) % 4 == 0)
+      movslback(dst + n - 4, src + n - 4, n/4);
+    else
+      movsbback(dst + n - 1, src + n - 1, n);
+    return vdst;
+  }
+  if(n >= 16 && ((uint)src ^ (uint)dst) % 4 == 0){
+    m = -(uint)dst % 4;
+    movsb(dst, src, m);
+    dst += m;
+    src += m;
+    n -= m;
+    movsl(dst, src, n/4);
+    dst += n & ~3;
+    src += n & ~3;
+    n %= 4;
+  }
+  movsb(dst, src, n);
   return vdst;
 }
 
+// Spin for number_of_clocks timer ticks.
 void 
 delay(int number_of_clocks)
 {
-    int first_clock = uptime();
-    int inc_clock = uptime();
-    while(inc_clock >= (first_clock + number_of_clocks) )
-    {
-        inc_clock = uptime();
+  uint first_clock = uuptime();
+
+  while(uuptime() - first_clock < number_of_clocks)
+    pause();
+}
+
+// The calling process's pid, ctime, queue and priority, and
+// the time since boot in ticks, read from the info and time
+// pages without a system call.
+int
+ugetpid(void)
+{
+  return ((struct infopage*)INFOPAGE)->pid;
+}
+
+int
+ugetctime(void)
+{
+  return ((struct infopage*)INFOPAGE)->ctime;
+}
+
+int
+ugetqueue(void)
+{
+  return ((struct infopage*)INFOPAGE)->sched_queue;
+}
+
+int
+ugetpriority(void)
+{
+  return ((struct infopage*)INFOPAGE)->priority;
+}
+
+uint
+uuptime(void)
+{
+  return ((struct timepage*)TIMEPAGE)->ticks;
+}
+// Nanoseconds since boot, read from the kernel's time page
+// without a system call.
+uint64
+nanotime(void)
+{
+  struct timepage *tp = (struct timepage*)TIMEPAGE;
+  uint seq;
+  uint64 ns, cyc;
+
+  do {
+    while((seq = tp->seq) & 1)
+      pause();
+    // Keep the compiler from moving the reads of the page
+    // outside the two reads of seq.  x86 does not reorder
+    // loads, so no fence is needed.
+    asm volatile("" : : : "memory");
+    ns = tp->base_ns;
+    if(tp->mult){
+      cyc = rdtsc() - tp->base_tsc;
+      ns += ((cyc >> 32) * tp->mult << (32 - tp->shift)) +
+            ((uint64)(uint)cyc * tp->mult >> tp->shift);
     }
-}
\ No newline at end of file
+    asm volatile("" : : : "memory");
+  } while(tp->seq != seq);
+  return ns;
+}
+
+// Like clock_gettime(), but without a system call.
+int
+uclock_gettime(struct timespec *ts)
+{
+  uint64 ns;
+
+  ns = nanotime();
+  // 64-by-32 bit divide; the quotient fits in 32 bits.
+  asm("divl %4" : "=a" (ts->tv_sec), "=d" (ts->tv_nsec) :
+      "a" ((uint)ns), "d" ((uint)(ns >> 32)), "rm" (1000000000));
+  return 0;
+}
+
+// Queue an operation on the system call ring (see ring.h),
+// which ring_enter(0) maps.  Returns -1 if the ring is full.
+int
+ringsubmit(int op, int flags, int fd, void *addr, int n, uint data)
+{
+  struct ring *r = (struct ring*)RINGPAGE;
+  struct sqe *e;
+
+  if(r->sqtail - r->sqhead >= NRING)
+    return -1;
+  e = &r->sq[r->sqtail % NRING];
+  e->op = op;
+  e->flags = flags;
+  e->fd = fd;
+  e->addr = (uint)addr;
+  e->n = n;
+  e->data = data;
+  r->sqtail++;
+  return 0;
+}
+
+// Take the next result off the system call ring.  Returns
+// -1 if there is none.
+int
+ringreap(struct cqe *c)
+{
+  struct ring *r = (struct ring*)RINGPAGE;
+
+  if(r->cqhead == r->cqtail)
+    return -1;
+  *c = r->cq[r->cqhead % NRING];
+  r->cqhead++;
+  return 0;
+}
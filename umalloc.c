@@ -3,88 +3,174 @@
 #include "user.h"
 #include "param.h"
 
-// Memory allocator by Kernighan and Ritchie,
-// The C programming Language, 2nd ed.  Section 8.7.
+// Memory allocator with size classes.
+//
+// Memory comes from sbrk() in runs of whole pages.  A request
+// of up to MAXSMALL bytes is rounded up to a power of 2 and
+// served from a slab: a page cut into objects of that size,
+// whose free objects sit on a list for the size.  A larger
+// request gets a run of pages of its own.  Free runs are kept
+// in address order and merged with their neighbours; slab
+// pages are never given back.
+//
+// Every slab and run begins with a struct page, so free()
+// finds an object's size from the page it lies in.
 
-typedef long Align;
+#define PGSIZE   4096
+#define MINSHIFT 3                // smallest class, 8 bytes
+#define NCLASS   8                // classes up to MAXSMALL
+#define MAXSMALL (1 << (MINSHIFT + NCLASS - 1))
+#define MAXLARGE 0x40000000
+#define MINGROW  8                // pages to ask sbrk() for at least
 
-union header {
-  struct {
-    union header *ptr;
-    uint size;
-  } s;
-  Align x;
+#define SLAB  1
+#define LARGE 2
+#define FREE  3
+
+struct page {
+  uint kind;
+  uint n;              // pages in a run, or a slab's class
+  struct page *next;   // next free run
+  uint pad;            // keep objects 16-byte aligned
 };
 
-typedef union header Header;
+struct object {
+  struct object *next;
+};
 
-static Header base;
-static Header *freep;
+static struct object *freeobj[NCLASS];
+static struct page *freeruns;  // in address order
 
-void
-free(void *ap)
+#define END(p)  ((char*)(p) + (p)->n * PGSIZE)
+
+// Free run p of n pages, merging it with free neighbours.
+static void
+putrun(struct page *p, uint n)
 {
-  Header *bp, *p;
-
-  bp = (Header*)ap - 1;
-  for(p = freep; !(bp > p && bp < p->s.ptr); p = p->s.ptr)
-    if(p >= p->s.ptr && (bp > p || bp < p->s.ptr))
-      break;
-  if(bp + bp->s.size == p->s.ptr){
-    bp->s.size += p->s.ptr->s.size;
-    bp->s.ptr = p->s.ptr->s.ptr;
-  } else
-    bp->s.ptr = p->s.ptr;
-  if(p + p->s.size == bp){
-    p->s.size += bp->s.size;
-    p->s.ptr = bp->s.ptr;
-  } else
-    p->s.ptr = bp;
-  freep = p;
+  struct page *prev, *q;
+
+  p->kind = FREE;
+  p->n = n;
+  for(prev = 0, q = freeruns; q && q < p; prev = q, q = q->next)
+    ;
+  p->next = q;
+  if(prev)
+    prev->next = p;
+  else
+    freeruns = p;
+  if(q && END(p) == (char*)q){
+    p->n += q->n;
+    p->next = q->next;
+  }
+  if(prev && END(prev) == (char*)p){
+    prev->n += p->n;
+    prev->next = p->next;
+  }
 }
 
-static Header*
-morecore(uint nu)
+// Allocate a run of n pages, first fit, growing the
+// heap if no free run is big enough.
+static struct page*
+getrun(uint n)
 {
-  char *p;
-  Header *hp;
+  struct page *p, *prev;
+  char *brk;
+  uint pad, grow;
 
-  if(nu < 4096)
-    nu = 4096;
-  p = sbrk(nu * sizeof(Header));
-  if(p == (char*)-1)
-    return 0;
-  hp = (Header*)p;
-  hp->s.size = nu;
-  free((void*)(hp + 1));
-  return freep;
+  for(prev = 0, p = freeruns; p; prev = p, p = p->next){
+    if(p->n > n){
+      // Take the end, which leaves the list alone.
+      p->n -= n;
+      return (struct page*)END(p);
+    }
+    if(p->n == n){
+      if(prev)
+        prev->next = p->next;
+      else
+        freeruns = p->next;
+      return p;
+    }
+  }
+
+  // The program may have moved the break itself, so
+  // page-align it first.
+  brk = sbrk(0);
+  pad = -(uint)brk % PGSIZE;
+  grow = n < MINGROW ? MINGROW : n;
+  if(sbrk(pad + grow*PGSIZE) == (char*)-1){
+    grow = n;
+    if(sbrk(pad + grow*PGSIZE) == (char*)-1)
+      return 0;
+  }
+  p = (struct page*)(brk + pad);
+  if(grow > n)
+    putrun((struct page*)((char*)p + n*PGSIZE), grow - n);
+  return p;
+}
+
+// Cut a new page into objects of class c.
+static int
+newslab(int c)
+{
+  struct page *p;
+  struct object *o;
+  char *a;
+  uint size;
+
+  if((p = getrun(1)) == 0)
+    return -1;
+  p->kind = SLAB;
+  p->n = c;
+  size = 1 << (c + MINSHIFT);
+  for(a = (char*)(p + 1); a + size <= (char*)p + PGSIZE; a += size){
+    o = (struct object*)a;
+    o->next = freeobj[c];
+    freeobj[c] = o;
+  }
+  return 0;
+}
+
+void
+free(void *ap)
+{
+  struct page *p;
+  struct object *o;
+
+  if(ap == 0)
+    return;
+  p = (struct page*)((uint)ap & ~(PGSIZE-1));
+  if(p->kind == SLAB){
+    o = ap;
+    o->next = freeobj[p->n];
+    freeobj[p->n] = o;
+  } else
+    putrun(p, p->n);
 }
 
 void*
 malloc(uint nbytes)
 {
-  Header *p, *prevp;
-  uint nunits;
+  struct page *p;
+  struct object *o;
+  uint n;
+  int c;
 
-  nunits = (nbytes + sizeof(Header) - 1)/sizeof(Header) + 1;
-  if((prevp = freep) == 0){
-    base.s.ptr = freep = prevp = &base;
-    base.s.size = 0;
-  }
-  for(p = prevp->s.ptr; ; prevp = p, p = p->s.ptr){
-    if(p->s.size >= nunits){
-      if(p->s.size == nunits)
-        prevp->s.ptr = p->s.ptr;
-      else {
-        p->s.size -= nunits;
-        p += p->s.size;
-        p->s.size = nunits;
-      }
-      freep = prevp;
-      return (void*)(p + 1);
-    }
-    if(p == freep)
-      if((p = morecore(nunits)) == 0)
-        return 0;
+  if(nbytes <= MAXSMALL){
+    for(c = 0; (1 << (c + MINSHIFT)) < nbytes; c++)
+      ;
+    if(freeobj[c] == 0 && newslab(c) < 0)
+      return 0;
+    o = freeobj[c];
+    freeobj[c] = o->next;
+    return o;
   }
+
+  if(nbytes > MAXLARGE)
+    return 0;
+  n = (nbytes + sizeof(struct page) + PGSIZE - 1) / PGSIZE;
+  if((p = getrun(n)) == 0)
+    return 0;
+  p->kind = LARGE;
+  p->n = n;
+  return p + 1;
 }
@@ -1,5 +1,10 @@
 struct stat;
 struct rtcdate;
+struct timespec;
+struct rusage;
+struct trevent;
+struct procinfo;
+struct cqe;
 
 // system calls
 int fork(void);
@@ -23,8 +28,8 @@ int getpid(void);
 char* sbrk(int);
 int sleep(int);
 int uptime(void);
-int get_descendant(int);
-int get_ancestors(int);
+int get_descendant(int, struct procinfo*, int);
+int get_ancestors(int, struct procinfo*, int);
 int get_creation_time(int);
 int calc_perfect_square(void);
 int sleep_time(void);
@@ -32,6 +37,21 @@ int change_queue(int, int);
 int set_priority(int, int);
 int set_ratio_process(int, int, int, int);
 int print_processes_details();
+void* mmap(void*, uint, int, int, int, int);
+int munmap(void*, uint);
+int pipesize(int, int);
+int splice(int, int, int);
+int clock_gettime(struct timespec*);
+int set_slice(int, int, int);
+int getrusage(int, struct rusage*);
+int tracedrain(struct trevent*, int);
+int ring_enter(int);
+
+// usys.S; the unbuffered forms of fork, exit, exec, close
+int _fork(void);
+int _exit(void) __attribute__((noreturn));
+int _exec(char*, char**);
+int _close(int);
 
 // ulib.c
 int stat(const char*, struct stat*);
@@ -40,10 +60,22 @@ void *memmove(void*, const void*, int);
 char* strchr(const char*, char c);
 int strcmp(const char*, const char*);
 void printf(int, const char*, ...);
+int fflush(int);
+void fflushall(void);
+void fdrelease(int);
 char* gets(char*, int max);
 uint strlen(const char*);
 void* memset(void*, int, uint);
 void* malloc(uint);
 void free(void*);
 int atoi(const char*);
-void delay(int number_of_clocks);
\ No newline at end of file
+void delay(int number_of_clocks);
+uint64 nanotime(void);
+int ugetpid(void);
+int ugetctime(void);
+int ugetqueue(void);
+int ugetpriority(void);
+uint uuptime(void);
+int uclock_gettime(struct timespec*);
+int ringsubmit(int, int, int, void*, int, uint);
+int ringreap(struct cqe*);
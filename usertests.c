@@ -7,6 +7,9 @@
 #include "syscall.h"
 #include "traps.h"
 #include "memlayout.h"
+#include "date.h"
+#include "procinfo.h"
+#include "ring.h"
 
 char buf[8192];
 char name[3];
@@ -354,6 +357,354 @@ pipe1(void)
   printf(1, "pipe1 ok\n");
 }
 
+// resize a pipe ring that holds wrapped-around data
+void
+pipesizetest(void)
+{
+  int fds[2], i, n;
+
+  printf(1, "pipesize test\n");
+  if(pipe(fds) != 0){
+    printf(1, "pipe() failed\n");
+    exit();
+  }
+  if(pipesize(fds[0], 0) != 4096){
+    printf(1, "pipesize: default size wrong\n");
+    exit();
+  }
+  // leave 3000 bytes in the ring, wrapped past its end
+  for(i = 0; i < 3000; i++)
+    buf[i] = i;
+  if(write(fds[1], buf, 3000) != 3000 || read(fds[0], buf, 3000) != 3000){
+    printf(1, "pipesize: fill failed\n");
+    exit();
+  }
+  for(i = 0; i < 3000; i++)
+    buf[i] = i * 7;
+  if(write(fds[1], buf, 3000) != 3000){
+    printf(1, "pipesize: write failed\n");
+    exit();
+  }
+  if(pipesize(fds[1], 1000) >= 0){
+    printf(1, "pipesize: shrank below unread data\n");
+    exit();
+  }
+  if(pipesize(fds[1], 10000) != 16384){
+    printf(1, "pipesize: grow failed\n");
+    exit();
+  }
+  if(write(fds[1], buf, 3000) != 3000){
+    printf(1, "pipesize: write after grow failed\n");
+    exit();
+  }
+  memset(buf, 0, 6000);
+  for(n = 0; n < 6000; n += i){
+    if((i = read(fds[0], buf + n, 6000 - n)) <= 0){
+      printf(1, "pipesize: read failed\n");
+      exit();
+    }
+  }
+  for(i = 0; i < 6000; i++){
+    if((buf[i] & 0xff) != ((i % 3000) * 7 & 0xff)){
+      printf(1, "pipesize: wrong data at %d\n", i);
+      exit();
+    }
+  }
+  close(fds[0]);
+  close(fds[1]);
+  printf(1, "pipesize ok\n");
+}
+
+// splice a file through two pipes into another file
+void
+splicetest(void)
+{
+  int fd, p1[2], p2[2], i, n;
+
+  printf(1, "splice test\n");
+  unlink("splice.in");
+  unlink("splice.out");
+  fd = open("splice.in", O_CREATE|O_RDWR);
+  for(i = 0; i < 3000; i++)
+    buf[i] = i * 3;
+  if(fd < 0 || write(fd, buf, 3000) != 3000){
+    printf(1, "splice: create failed\n");
+    exit();
+  }
+  close(fd);
+  if(pipe(p1) != 0 || pipe(p2) != 0){
+    printf(1, "pipe() failed\n");
+    exit();
+  }
+  if(splice(p1[0], p2[0], 1) >= 0){
+    printf(1, "splice: spliced into a read end\n");
+    exit();
+  }
+
+  fd = open("splice.in", 0);
+  if(splice(fd, p1[1], 5000) != 3000 || splice(fd, p1[1], 10) != 0){
+    printf(1, "splice: file to pipe failed\n");
+    exit();
+  }
+  close(fd);
+  close(p1[1]);
+  for(n = 0; (i = splice(p1[0], p2[1], 4096)) > 0; n += i)
+    ;
+  if(n != 3000){
+    printf(1, "splice: pipe to pipe moved %d\n", n);
+    exit();
+  }
+  close(p1[0]);
+  close(p2[1]);
+  fd = open("splice.out", O_CREATE|O_RDWR);
+  if(fd < 0 || splice(p2[0], fd, 4096) != 3000){
+    printf(1, "splice: pipe to file failed\n");
+    exit();
+  }
+  close(fd);
+  close(p2[0]);
+
+  fd = open("splice.out", 0);
+  memset(buf, 0, 3000);
+  if(read(fd, buf, sizeof(buf)) != 3000){
+    printf(1, "splice: wrong output size\n");
+    exit();
+  }
+  close(fd);
+  for(i = 0; i < 3000; i++){
+    if((buf[i] & 0xff) != (i * 3 & 0xff)){
+      printf(1, "splice: wrong data at %d\n", i);
+      exit();
+    }
+  }
+  unlink("splice.in");
+  unlink("splice.out");
+  printf(1, "splice ok\n");
+}
+
+// the syscall clock and the time page agree and are monotonic
+void
+clocktest(void)
+{
+  struct timespec a, b, c;
+
+  printf(1, "clock test\n");
+  if(clock_gettime(&a) < 0){
+    printf(1, "clock_gettime failed\n");
+    exit();
+  }
+  uclock_gettime(&b);
+  sleep(2);
+  clock_gettime(&c);
+  if(b.tv_sec < a.tv_sec || (b.tv_sec == a.tv_sec && b.tv_nsec < a.tv_nsec) ||
+     c.tv_sec < b.tv_sec || (c.tv_sec == b.tv_sec && c.tv_nsec <= b.tv_nsec)){
+    printf(1, "clock went backwards\n");
+    exit();
+  }
+  if(a.tv_nsec >= 1000000000 || b.tv_nsec >= 1000000000){
+    printf(1, "clock: bad tv_nsec\n");
+    exit();
+  }
+  printf(1, "clock ok\n");
+}
+
+// Overlapping memmoves with dst above src copy backward with
+// the direction flag set.  Interrupts taken in the middle of
+// one, while another process forks, must not leave the flag
+// set in the kernel.
+void
+memmovedftest(void)
+{
+  static char buf[8192+4];
+  int pid, i, j, off, n;
+
+  printf(1, "memmove df test\n");
+  pid = fork();
+  if(pid < 0){
+    printf(1, "memmove df: fork failed\n");
+    exit();
+  }
+  if(pid == 0){
+    for(i = 0; i < 200; i++){
+      if((n = fork()) == 0)
+        exit();
+      if(n > 0)
+        wait();
+    }
+    exit();
+  }
+  for(i = 0; i < 500; i++){
+    off = i % 2 ? 1 : 4;  // movsbback, then movslback
+    for(j = 0; j < 8192; j++)
+      buf[j] = j;
+    memmove(buf+off, buf, 8192);
+    for(j = 0; j < 8192; j++){
+      if(buf[j+off] != (char)j){
+        printf(1, "memmove df: bad copy\n");
+        exit();
+      }
+    }
+  }
+  wait();
+  printf(1, "memmove df ok\n");
+}
+
+// calc_perfect_square() takes its argument in %edx, which
+// must survive the trip into the kernel.
+void
+perfectsquaretest(void)
+{
+  int r;
+
+  printf(1, "perfect square test\n");
+  asm volatile("call calc_perfect_square" : "=a" (r) : "d" (50) : "ecx", "memory");
+  if(r != 49){
+    printf(1, "perfect square: got %d for 50\n", r);
+    exit();
+  }
+  asm volatile("call calc_perfect_square" : "=a" (r) : "d" (16) : "ecx", "memory");
+  if(r != 16){
+    printf(1, "perfect square: got %d for 16\n", r);
+    exit();
+  }
+  printf(1, "perfect square ok\n");
+}
+
+// The info and time pages agree with the system calls, in a
+// forked child too.
+void
+infopagetest(void)
+{
+  uint t;
+  int pid;
+
+  printf(1, "info page test\n");
+  t = uuptime();
+  if(ugetpid() != getpid() || ugetctime() != get_creation_time(0) ||
+     uptime() - t > 1){
+    printf(1, "info page: wrong values\n");
+    exit();
+  }
+  set_priority(getpid(), 3);
+  if(ugetpriority() != 3){
+    printf(1, "info page: priority not updated\n");
+    exit();
+  }
+  set_priority(getpid(), 10);
+  pid = fork();
+  if(pid < 0){
+    printf(1, "info page: fork failed\n");
+    exit();
+  }
+  if(pid == 0){
+    if(ugetpid() != getpid())
+      printf(1, "info page: wrong pid in child\n");
+    exit();
+  }
+  wait();
+  printf(1, "info page ok\n");
+}
+
+// File operations batched on the system call ring.
+void
+ringtest(void)
+{
+  static int want[] = { 0, 5, 0, 0, 5, 0, 0, -1 };
+  struct stat st;
+  struct cqe c;
+  char buf[8];
+  int i;
+
+  printf(1, "ring test\n");
+  if(ring_enter(0) != 0){
+    printf(1, "ring: ring_enter failed\n");
+    exit();
+  }
+  ringsubmit(RING_OPEN, 0, 0, "ringfile", O_CREATE|O_RDWR, 0);
+  ringsubmit(RING_WRITE, RING_LASTFD, 0, "hello", 5, 1);
+  ringsubmit(RING_CLOSE, RING_LASTFD, 0, 0, 0, 2);
+  ringsubmit(RING_OPEN, 0, 0, "ringfile", O_RDONLY, 3);
+  ringsubmit(RING_READ, RING_LASTFD, 0, buf, 5, 4);
+  ringsubmit(RING_FSTAT, RING_LASTFD, 0, &st, 0, 5);
+  ringsubmit(RING_CLOSE, RING_LASTFD, 0, 0, 0, 6);
+  ringsubmit(RING_CLOSE, 0, NOFILE, 0, 0, 7);
+  if(ring_enter(8) != 8){
+    printf(1, "ring: ring_enter ran too few\n");
+    exit();
+  }
+  for(i = 0; i < 8; i++){
+    if(ringreap(&c) < 0 || c.data != i ||
+       (i == 0 || i == 3 ? c.res < 0 : c.res != want[i])){
+      printf(1, "ring: bad result %d\n", i);
+      exit();
+    }
+  }
+  buf[5] = 0;
+  if(ringreap(&c) == 0 || strcmp(buf, "hello") != 0 || st.size != 5){
+    printf(1, "ring: bad data\n");
+    exit();
+  }
+  unlink("ringfile");
+  printf(1, "ring ok\n");
+}
+
+// get_descendant() and get_ancestors() on a child and a
+// grandchild that block on a pipe until the checks are done.
+void
+proctreetest(void)
+{
+  struct procinfo buf[4];
+  int ready[2], hold[2], pid, gpid, n;
+  char c;
+
+  printf(1, "proctree test\n");
+  if(pipe(ready) < 0 || pipe(hold) < 0){
+    printf(1, "proctree: pipe failed\n");
+    exit();
+  }
+  pid = fork();
+  if(pid < 0){
+    printf(1, "proctree: fork failed\n");
+    exit();
+  }
+  if(pid == 0){
+    close(hold[1]);
+    gpid = fork();
+    if(gpid == 0){
+      read(hold[0], &c, 1);
+      exit();
+    }
+    write(ready[1], &gpid, sizeof(gpid));
+    wait();
+    exit();
+  }
+  close(hold[0]);
+  if(read(ready[0], &gpid, sizeof(gpid)) != sizeof(gpid)){
+    printf(1, "proctree: read failed\n");
+    exit();
+  }
+  n = get_descendant(getpid(), buf, 4);
+  if(n != 2 || buf[0].pid != pid || buf[0].depth != 1 ||
+     buf[1].pid != gpid || buf[1].ppid != pid || buf[1].depth != 2){
+    printf(1, "proctree: bad descendants\n");
+    exit();
+  }
+  n = get_ancestors(gpid, buf, 2);
+  if(n != 2 || buf[0].pid != pid || buf[1].pid != getpid()){
+    printf(1, "proctree: bad ancestors\n");
+    exit();
+  }
+  close(hold[1]);
+  close(ready[0]);
+  close(ready[1]);
+  wait();
+  if(get_ancestors(pid, buf, 2) != -1){
+    printf(1, "proctree: reaped process still found\n");
+    exit();
+  }
+  printf(1, "proctree ok\n");
+}
+
 // meant to be run w/ at most two CPUs
 void
 preempt(void)
@@ -1347,7 +1698,7 @@ iref(void)
 
   printf(1, "empty file name\n");
 
-  // the 50 is NINODE
+  // the 50 was NINODE, the old limit on in-memory inodes
   for(i = 0; i < 50 + 1; i++){
     if(mkdir("irefd") != 0){
       printf(1, "mkdir irefd failed\n");
@@ -1374,8 +1725,8 @@ iref(void)
 }
 
 // test that fork fails gracefully
-// the forktest binary also does this, but it runs out of proc entries first.
-// inside the bigger usertests binary, we run out of memory first.
+// the forktest binary also does this, with a smaller image.
+// either way we run out of memory, not proc table entries.
 void
 forktest(void)
 {
@@ -1383,7 +1734,7 @@ forktest(void)
 
   printf(1, "fork test\n");
 
-  for(n=0; n<1000; n++){
+  for(n=0; n<100000; n++){
     pid = fork();
     if(pid < 0)
       break;
@@ -1391,8 +1742,12 @@ forktest(void)
       exit();
   }
 
-  if(n == 1000){
-    printf(1, "fork claimed to work 1000 times!\n");
+  if(n == 100000){
+    printf(1, "fork claimed to work 100000 times!\n");
+    exit();
+  }
+  if(n <= 64){
+    printf(1, "fork failed after %d processes\n", n);
     exit();
   }
 
@@ -1737,6 +2092,79 @@ void argptest()
   printf(1, "arg test passed\n");
 }
 
+// mmap a file MAP_SHARED, check that stores are written
+// back on munmap, and share anonymous memory with a child.
+void
+mmaptest(void)
+{
+  int fd, i, pid;
+  char *p;
+
+  printf(stdout, "mmap test\n");
+
+  for(i = 0; i < 6000; i++)
+    buf[i] = 'a' + i%26;
+  fd = open("mmapfile", O_CREATE|O_RDWR);
+  if(fd < 0 || write(fd, buf, 6000) != 6000){
+    printf(stdout, "mmap: create mmapfile failed\n");
+    exit();
+  }
+  p = mmap(0, 6000, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+  if(p == (char*)-1){
+    printf(stdout, "mmap failed\n");
+    exit();
+  }
+  for(i = 0; i < 6000; i++){
+    if(p[i] != buf[i]){
+      printf(stdout, "mmap: wrong content at %d\n", i);
+      exit();
+    }
+  }
+  if(p[6000] != 0){
+    printf(stdout, "mmap: page past end of file not zeroed\n");
+    exit();
+  }
+  p[0] = 'Z';
+  p[5999] = 'Y';
+  if(munmap(p, 6000) < 0){
+    printf(stdout, "munmap failed\n");
+    exit();
+  }
+  close(fd);
+
+  fd = open("mmapfile", O_RDONLY);
+  if(fd < 0 || read(fd, buf, 6000) != 6000 || buf[0] != 'Z' || buf[5999] != 'Y'){
+    printf(stdout, "mmap: shared stores not written back\n");
+    exit();
+  }
+  close(fd);
+  unlink("mmapfile");
+
+  p = mmap(0, 4096, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+  if(p == (char*)-1){
+    printf(stdout, "mmap anonymous failed\n");
+    exit();
+  }
+  p[0] = 1;
+  pid = fork();
+  if(pid < 0){
+    printf(stdout, "fork failed\n");
+    exit();
+  }
+  if(pid == 0){
+    p[0] = 42;
+    exit();
+  }
+  wait();
+  if(p[0] != 42){
+    printf(stdout, "mmap: anonymous memory not shared with child\n");
+    exit();
+  }
+  munmap(p, 4096);
+
+  printf(stdout, "mmap test ok\n");
+}
+
 unsigned long randstate = 1;
 unsigned int
 rand()
@@ -1780,7 +2208,16 @@ main(int argc, char *argv[])
   iputtest();
 
   mem();
+  mmaptest();
   pipe1();
+  pipesizetest();
+  splicetest();
+  clocktest();
+  proctreetest();
+  ringtest();
+  infopagetest();
+  perfectsquaretest();
+  memmovedftest();
   preempt();
   exitwait();
 
@@ -8,7 +8,25 @@
 #include "elf.h"
 
 extern char data[];  // defined by kernel.ld
+extern char sysentry[];  // in trapasm.S
 pde_t *kpgdir;  // for use in scheduler()
+static int sep;  // CPUs have sysenter/sysexit
+
+// Does this CPU have working sysenter/sysexit?  Early
+// Pentium Pros report SEP but do not implement it.
+int
+sysenterok(void)
+{
+  uint a, b, c, d, family, model, stepping;
+
+  cpuidregs(1, &a, &b, &c, &d);
+  family = (a >> 8) & 0xF;
+  model = (a >> 4) & 0xF;
+  stepping = a & 0xF;
+  if(family == 6 && model < 3 && stepping < 3)
+    return 0;
+  return (d & (1 << 11)) != 0;
+}
 
 // Set up CPU's kernel segment descriptors.
 // Run once on entry on each CPU.
@@ -27,12 +45,21 @@ seginit(void)
   c->gdt[SEG_UCODE] = SEG(STA_X|STA_R, 0, 0xffffffff, DPL_USER);
   c->gdt[SEG_UDATA] = SEG(STA_W, 0, 0xffffffff, DPL_USER);
   lgdt(c->gdt, sizeof(c->gdt));
+
+  // sysenter loads CS from the MSR and SS from the next
+  // descriptor; sysexit loads the two after that, with
+  // RPL 3.  That matches SEG_KCODE..SEG_UDATA above.  The
+  // stack to enter on is set by switchuvm().
+  if((sep = sysenterok()) != 0){
+    wrmsr(MSR_SYSENTER_CS, SEG_KCODE << 3);
+    wrmsr(MSR_SYSENTER_EIP, (uint)sysentry);
+  }
 }
 
 // Return the address of the PTE in page table pgdir
 // that corresponds to virtual address va.  If alloc!=0,
 // create any required page table pages.
-static pte_t *
+pte_t *
 walkpgdir(pde_t *pgdir, const void *va, int alloc)
 {
   pde_t *pde;
@@ -57,7 +84,7 @@ walkpgdir(pde_t *pgdir, const void *va, int alloc)
 // Create PTEs for virtual addresses starting at va that refer to
 // physical addresses starting at pa. va and size might not
 // be page-aligned.
-static int
+int
 mappages(pde_t *pgdir, void *va, uint size, uint pa, int perm)
 {
   char *a, *last;
@@ -132,6 +159,10 @@ setupkvm(void)
       freevm(pgdir);
       return 0;
     }
+  if(maptimepage(pgdir) < 0){
+    freevm(pgdir);
+    return 0;
+  }
   return pgdir;
 }
 
@@ -169,6 +200,8 @@ switchuvm(struct proc *p)
   mycpu()->gdt[SEG_TSS].s = 0;
   mycpu()->ts.ss0 = SEG_KDATA << 3;
   mycpu()->ts.esp0 = (uint)p->kstack + KSTACKSIZE;
+  if(sep)
+    wrmsr(MSR_SYSENTER_ESP, (uint)p->kstack + KSTACKSIZE);
   // setting IOPL=0 in eflags *and* iomb beyond the tss segment limit
   // forbids I/O instructions (e.g., inb and outb) from user space
   mycpu()->ts.iomb = (ushort) 0xFFFF;
@@ -224,7 +257,7 @@ allocuvm(pde_t *pgdir, uint oldsz, uint newsz)
   char *mem;
   uint a;
 
-  if(newsz >= KERNBASE)
+  if(newsz > USERTOP)
     return 0;
   if(newsz < oldsz)
     return oldsz;
@@ -337,6 +370,16 @@ copyuvm(pde_t *pgdir, uint sz)
       goto bad;
     }
   }
+  // The system call ring, if there is one.
+  if((pte = walkpgdir(pgdir, (void*)RINGPAGE, 0)) != 0 && (*pte & PTE_P)){
+    if((mem = kalloc()) == 0)
+      goto bad;
+    memmove(mem, (char*)P2V(PTE_ADDR(*pte)), PGSIZE);
+    if(mappages(d, (void*)RINGPAGE, PGSIZE, V2P(mem), PTE_FLAGS(*pte)) < 0) {
+      kfree(mem);
+      goto bad;
+    }
+  }
   return d;
 
 bad:
@@ -344,6 +387,38 @@ bad:
   return 0;
 }
 
+// Map a process's info page read-only at INFOPAGE in pgdir.
+int
+mapinfo(pde_t *pgdir, char *info)
+{
+  kdup(info);
+  if(mappages(pgdir, (char*)INFOPAGE, PGSIZE, V2P(info), PTE_U) < 0){
+    kfree(info);
+    return -1;
+  }
+  return 0;
+}
+
+// Map a zeroed page at RINGPAGE in pgdir for the system
+// call ring, unless it is there already.
+int
+mapring(pde_t *pgdir)
+{
+  pte_t *pte;
+  char *mem;
+
+  if((pte = walkpgdir(pgdir, (char*)RINGPAGE, 0)) != 0 && (*pte & PTE_P))
+    return 0;
+  if((mem = kalloc()) == 0)
+    return -1;
+  memset(mem, 0, PGSIZE);
+  if(mappages(pgdir, (char*)RINGPAGE, PGSIZE, V2P(mem), PTE_W|PTE_U) < 0){
+    kfree(mem);
+    return -1;
+  }
+  return 0;
+}
+
 //PAGEBREAK!
 // Map user virtual address to kernel address.
 char*
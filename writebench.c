@@ -0,0 +1,60 @@
+// Measure file write throughput in blocks per second.
+// usage: writebench [kilobytes [chunk]]
+// Compare a small chunk (e.g. 512) with a large one to see
+// the effect of bigger log transactions.
+
+#include "types.h"
+#include "user.h"
+#include "fcntl.h"
+#include "fs.h"
+
+#define BUFSZ  (64*1024)
+#define FILESZ (64*1024)
+
+char buf[BUFSZ];
+
+int
+main(int argc, char *argv[])
+{
+  int fd, kb, chunk, n;
+  uint total, left, size, start, ticks;
+
+  kb = argc > 1 ? atoi(argv[1]) : 1024;
+  chunk = argc > 2 ? atoi(argv[2]) : BUFSZ;
+  if(kb <= 0 || chunk <= 0 || chunk > BUFSZ){
+    printf(2, "usage: writebench [kilobytes [chunk]]\n");
+    exit();
+  }
+  total = kb * 1024;
+  memset(buf, 'w', sizeof(buf));
+
+  // A file holds at most MAXFILE blocks, so the data is
+  // written as a series of files of FILESZ bytes.
+  start = uptime();
+  for(left = total; left > 0; ){
+    unlink("writebench.tmp");
+    if((fd = open("writebench.tmp", O_CREATE|O_WRONLY)) < 0){
+      printf(2, "writebench: cannot create file\n");
+      exit();
+    }
+    for(size = 0; size < FILESZ && left > 0; size += n, left -= n){
+      n = left < chunk ? left : chunk;
+      if(n > FILESZ - size)
+        n = FILESZ - size;
+      if(write(fd, buf, n) != n){
+        printf(2, "writebench: write failed\n");
+        exit();
+      }
+    }
+    close(fd);
+  }
+  ticks = uptime() - start;
+  unlink("writebench.tmp");
+  if(ticks == 0)
+    ticks = 1;
+
+  // uptime() counts 100 ticks a second.
+  printf(1, "%d KB in %d byte writes: %d ticks, %d blocks/s\n",
+         kb, chunk, ticks, (total / BSIZE) * 100 / ticks);
+  exit();
+}